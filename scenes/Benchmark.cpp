@@ -0,0 +1,350 @@
+// Headless ocean benchmark: bakes and runs OceanFFTGenerator for every TextureSize/TextureCount of
+// the sweep and prints per-stage GPU times as CSV, one row per configuration and stage:
+//   size,cascades,stage,samples,min_ms,avg_ms,p99_ms
+// Stages are the GpuProfiler scopes (gpuProfiler.h): bake, evolve, ifft, assemble and frame around
+// the public calls, the "ocean ..." scopes OceanFFTGenerator records inside them, and wall, the CPU
+// time per frame including the final glFinish.
+//
+// On Linux the context is a surfaceless EGL one, so it runs on Mesa llvmpipe without a GPU or a
+// display; on Windows it is a hidden GLFW window. Runs from the repository root (shaders/ is looked
+// up from the working directory). Built on its own, next to Cap2: the oceanBenchmark project of
+// Cap2.sln on Windows, `make` (Makefile) on Linux.
+//
+// oceanBenchmark [--frames N] [--warmup N] [--sizes MIN-MAX] [--counts MIN-MAX] [--out file.csv]
+//
+// --accuracy runs OceanFFTGenerator::MeasureAccuracy instead, at every size of --sizes with the
+// largest cascade count, seeds 1, 2 and 3 and a handful of fixed times, one row per variant, seed,
+// time and stage (initial, evolved, displacement, slope, foam):
+//   size,cascades,variant,precision,seed,time,stage,max_error,rms_error,reference_rms,gpu_ms
+// With --tolerance X it is a gate: the exit code is 3 when any stage's RMS error exceeds X times
+// the RMS of its reference.
+//
+// --cpu checks and times OceanCPUGenerator (oceanCPU.h) instead and needs no OpenGL context: at
+// every size of --sizes (64-256 unless given) with the largest cascade count, the last cascade at
+// half the size to cover per-layer TextureSize, each stage against oceanReference at a fixed time,
+// one row per cascade and stage, cpu_ms the wall time of OceanCPUGenerator::Update:
+//   size,cascades,layer,layer_size,stage,max_error,rms_error,reference_rms,cpu_ms
+// --tolerance gates it the same way.
+#include <glad/glad.h>
+#if defined(_WIN32)
+#include <GLFW/glfw3.h>
+#else
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+// ocean.h leans on the using directive Model.h gives Main.cpp
+using namespace std;
+#include <ocean.h>
+#include <oceanCPU.h>
+
+#if defined(_WIN32)
+static bool CreateHeadlessContext() {
+    if (!glfwInit())
+        return false;
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "oceanBenchmark", NULL, NULL);
+    if (!window)
+        return false;
+    glfwMakeContextCurrent(window);
+    return gladLoadGLLoader((GLADloadproc)glfwGetProcAddress) != 0;
+}
+#else
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+static bool CreateHeadlessContext() {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API))
+        return false;
+
+    // no surface is ever made current, a config is only needed by drivers without EGL_KHR_no_config_context
+    const EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config = (EGLConfig)0;
+    EGLint configs = 0;
+    eglChooseConfig(display, configAttributes, &config, 1, &configs);
+    if (configs == 0)
+        config = (EGLConfig)0;
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+        return false;
+    return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+}
+#endif
+
+// "a-b" or "a"
+static void ParseRange(const char* text, int& low, int& high) {
+    std::string range = text;
+    size_t dash = range.find('-');
+    low = atoi(range.substr(0, dash).c_str());
+    high = dash == std::string::npos ? low : atoi(range.substr(dash + 1).c_str());
+}
+
+static int RunAccuracy(OceanFFTGenerator& ocean, std::ostream& out, int minSize, int maxSize, int count, int frames, double tolerance) {
+    // fixed times, the last one several repeat periods in where a float phase has lost digits
+    const std::vector<int> seeds = { 1, 2, 3 };
+    const std::vector<float> times = { 0.0f, 1.5f, 37.25f, 1000.0f };
+    out << "size,cascades,variant,precision,seed,time,stage,max_error,rms_error,reference_rms,gpu_ms" << endl;
+    bool failed = false;
+    for (int size = minSize; size <= maxSize; size *= 2) {
+        perChangeParameters parameters = DefaultParameters();
+        parameters.TextureSize = size;
+        parameters.TextureCount = count;
+        for (const AccuracyMeasurement& result : ocean.MeasureAccuracy(parameters, seeds, times, frames)) {
+            const oceanReference::StageError* stages[] = { &result.initialSpectrum, &result.evolvedSpectrum,
+                &result.displacement, &result.slope, &result.foam };
+            const char* names[] = { "initial", "evolved", "displacement", "slope", "foam" };
+            for (int s = 0; s < 5; ++s) {
+                const oceanReference::StageError& stage = *stages[s];
+                // the fused passes never write the evolved spectrum
+                if (stage.referenceRMS == 0 && stage.maxError == 0)
+                    continue;
+                out << size << ',' << count << ',' << result.variant << ',' << (result.precision.outputs ? "fp32" : "default") << ','
+                    << result.seed << ',' << result.time << ',' << names[s] << ',' << stage.maxError << ',' << stage.rmsError << ','
+                    << stage.referenceRMS << ',' << result.gpuMs << '\n';
+                if (tolerance > 0 && stage.rmsError > tolerance * stage.referenceRMS) {
+                    cerr << "FAIL " << size << ' ' << result.variant << ' ' << names[s] << " seed " << result.seed << " time " << result.time
+                         << ": rms " << stage.rmsError << " > " << tolerance << " * " << stage.referenceRMS << endl;
+                    failed = true;
+                }
+            }
+        }
+        out.flush();
+    }
+    return failed ? 3 : 0;
+}
+
+static int RunCpu(std::ostream& out, int minSize, int maxSize, int count, int frames, double tolerance) {
+    // several repeat periods in, like RunAccuracy's last time
+    const float time = 37.25f;
+    OceanCPUGenerator cpu;
+    out << "size,cascades,layer,layer_size,stage,max_error,rms_error,reference_rms,cpu_ms" << endl;
+    bool failed = false;
+    std::vector<glm::dvec4> initial, spectrum, displacement;
+    std::vector<glm::dvec2> slope;
+    std::vector<double> foam;
+    for (int size = minSize; size <= maxSize; size *= 2) {
+        perChangeParameters parameters = DefaultParameters();
+        parameters.TextureSize = size;
+        parameters.TextureCount = count;
+        if (count > 1 && size > 16)
+            parameters.layers[count - 1].TextureSize = size / 2;
+        cpu.InitialBake(parameters);
+        cpu.CalculateSpectrum();
+
+        auto start = std::chrono::steady_clock::now();
+        for (int f = 0; f < frames; ++f)
+            cpu.Update(f / 60.0f);
+        double cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / std::max(frames, 1);
+
+        // foam decays from whatever the last frame left
+        std::vector<std::vector<double>> foamBefore(count);
+        for (int i = 0; i < count; ++i) {
+            int layerSize = cpu.Size(i);
+            foamBefore[i].resize((size_t)layerSize * layerSize);
+            for (size_t t = 0; t < foamBefore[i].size(); ++t)
+                foamBefore[i][t] = cpu.Displacement(i)[t].w;
+        }
+        cpu.Update(time);
+
+        for (int i = 0; i < count; ++i) {
+            int layerSize = cpu.Size(i);
+            SpectrumSettings spectrum1, spectrum2;
+            FillSpectrumStruct(parameters.layers[i].spec1, spectrum1, parameters.Gravity);
+            FillSpectrumStruct(parameters.layers[i].spec2, spectrum2, parameters.Gravity);
+            oceanReference::BakeSettings bake = { layerSize, i, (double)parameters.layers[i].DomainSize, parameters.Gravity, parameters.Depth,
+                parameters.lowCutOff, parameters.highCutOff, parameters.seed, &spectrum1, &spectrum2 };
+            oceanReference::InitialSpectrum(bake, initial);
+            oceanReference::ErrorAccumulator initialError, displacementError, slopeError, foamError;
+            const glm::vec4* cpuInitial = cpu.InitialSpectrum(i);
+            for (size_t t = 0; t < initial.size(); ++t)
+                for (int c = 0; c < 4; ++c)
+                    initialError.Add(cpuInitial[t][c], initial[t][c]);
+
+            // the later stages from the CPU's own initial spectrum, so each is measured on its own
+            for (size_t t = 0; t < initial.size(); ++t)
+                initial[t] = glm::dvec4(cpuInitial[t]);
+            oceanReference::EvolveSpectrum(layerSize, parameters.layers[i].DomainSize, parameters.Gravity, cpu.frame.repeatTime, time, initial, spectrum);
+            oceanReference::IFFT(layerSize, spectrum);
+            foam = foamBefore[i];
+            oceanReference::Assemble(layerSize, spectrum, cpu.frame, foam, displacement, slope);
+            const glm::vec4* cpuDisplacement = cpu.Displacement(i);
+            const glm::vec2* cpuSlope = cpu.Slope(i);
+            for (size_t t = 0; t < displacement.size(); ++t) {
+                for (int c = 0; c < 3; ++c)
+                    displacementError.Add(cpuDisplacement[t][c], displacement[t][c]);
+                foamError.Add(cpuDisplacement[t].w, displacement[t].w);
+                for (int c = 0; c < 2; ++c)
+                    slopeError.Add(cpuSlope[t][c], slope[t][c]);
+            }
+
+            const oceanReference::StageError stages[] = { initialError.Result(), displacementError.Result(), slopeError.Result(), foamError.Result() };
+            const char* names[] = { "initial", "displacement", "slope", "foam" };
+            for (int s = 0; s < 4; ++s) {
+                const oceanReference::StageError& stage = stages[s];
+                out << size << ',' << count << ',' << i << ',' << layerSize << ',' << names[s] << ',' << stage.maxError << ','
+                    << stage.rmsError << ',' << stage.referenceRMS << ',' << cpuMs << '\n';
+                if (tolerance > 0 && stage.rmsError > tolerance * stage.referenceRMS) {
+                    cerr << "FAIL cpu " << size << " layer " << i << ' ' << names[s] << ": rms " << stage.rmsError
+                         << " > " << tolerance << " * " << stage.referenceRMS << endl;
+                    failed = true;
+                }
+            }
+        }
+        out.flush();
+    }
+    return failed ? 3 : 0;
+}
+
+int main(int argc, char** argv) {
+    int frames = 64;
+    // unmeasured frames first, drivers compile and allocate lazily on the first dispatches
+    int warmup = 4;
+    int minSize = 16, maxSize = 2048;
+    int minCount = 1, maxCount = MAX_CASCADES;
+    std::string outPath;
+    bool accuracy = false, cpu = false, sizesGiven = false;
+    double tolerance = 0;
+    for (int i = 1; i < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--accuracy" || option == "--cpu") {
+            (option == "--cpu" ? cpu : accuracy) = true;
+            --i;
+            continue;
+        }
+        if (i + 1 == argc) {
+            cerr << "missing value for " << option << endl;
+            return 2;
+        }
+        if (option == "--frames") frames = std::max(1, atoi(argv[i + 1]));
+        else if (option == "--warmup") warmup = std::max(0, atoi(argv[i + 1]));
+        else if (option == "--sizes") {
+            ParseRange(argv[i + 1], minSize, maxSize);
+            sizesGiven = true;
+        }
+        else if (option == "--counts") ParseRange(argv[i + 1], minCount, maxCount);
+        else if (option == "--out") outPath = argv[i + 1];
+        else if (option == "--tolerance") tolerance = atof(argv[i + 1]);
+        else {
+            cerr << "unknown option " << option << endl;
+            return 2;
+        }
+    }
+    minCount = glm::clamp(minCount, 1, MAX_CASCADES);
+    maxCount = glm::clamp(maxCount, minCount, MAX_CASCADES);
+
+    if (cpu) {
+        if (!sizesGiven) {
+            minSize = 64;
+            maxSize = 256;
+        }
+        std::ofstream file;
+        if (!outPath.empty())
+            file.open(outPath, std::ios::trunc);
+        return RunCpu(outPath.empty() ? cout : file, minSize, maxSize, maxCount, frames, tolerance);
+    }
+
+    if (!CreateHeadlessContext()) {
+        cerr << "could not create a headless OpenGL 4.3 core context" << endl;
+        return 1;
+    }
+    // the CSV goes to stdout (or --out), the generator's cout logging is moved to stderr
+    std::ostream stdoutStream(cout.rdbuf());
+    cout.rdbuf(cerr.rdbuf());
+    std::ofstream file;
+    if (!outPath.empty())
+        file.open(outPath, std::ios::trunc);
+    std::ostream& out = outPath.empty() ? stdoutStream : file;
+    cerr << "renderer: " << glGetString(GL_RENDERER) << ", " << glGetString(GL_VERSION) << endl;
+
+    std::vector<Layer> layers;
+    OceanFFTGenerator ocean(layers);
+    // every configuration bakes from scratch
+    ocean.useSpectrumCache = false;
+    ocean.DisableHeightQueries();
+
+    if (accuracy) {
+        int status = RunAccuracy(ocean, out, minSize, maxSize, maxCount, frames, tolerance);
+        cout.rdbuf(stdoutStream.rdbuf());
+        return status;
+    }
+    out << "size,cascades,stage,samples,min_ms,avg_ms,p99_ms" << endl;
+
+    for (int size = minSize; size <= maxSize; size *= 2) {
+        for (int count = minCount; count <= maxCount; ++count) {
+            GpuProfiler profiler;
+            ocean.profiler = &profiler;
+
+            perChangeParameters parameters = DefaultParameters();
+            parameters.TextureSize = size;
+            parameters.TextureCount = count;
+            profiler.BeginFrame();
+            {
+                GpuProfiler::Scope scope(&profiler, "bake");
+                ocean.InitialBake(parameters);
+                ocean.CalculateSpectrum();
+            }
+
+            ocean.profiler = nullptr;
+            for (int f = 0; f < warmup; ++f) {
+                ocean.EvolveSpectrum(f / 60.0f);
+                ocean.IFFT();
+                ocean.AssembleTextures();
+            }
+            ocean.profiler = &profiler;
+            glFinish();
+            auto start = std::chrono::steady_clock::now();
+            for (int f = 0; f < frames; ++f) {
+                profiler.BeginFrame();
+                GpuProfiler::Scope frame(&profiler, "frame");
+                float time = f / 60.0f;
+                {
+                    GpuProfiler::Scope scope(&profiler, "evolve");
+                    ocean.EvolveSpectrum(time);
+                }
+                {
+                    GpuProfiler::Scope scope(&profiler, "ifft");
+                    ocean.IFFT();
+                }
+                {
+                    GpuProfiler::Scope scope(&profiler, "assemble");
+                    ocean.AssembleTextures();
+                }
+            }
+            glFinish();
+            double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+            // everything has landed, these only collect
+            profiler.enabled = false;
+            for (int k = 0; k <= GpuProfiler::FRAMES_IN_FLIGHT; ++k)
+                profiler.BeginFrame();
+            for (const GpuProfiler::Stat& stat : profiler.Stats())
+                out << size << ',' << count << ',' << stat.name << ',' << stat.samples << ','
+                    << stat.minMs << ',' << stat.avgMs << ',' << stat.p99Ms << '\n';
+            out << size << ',' << count << ",wall," << frames << ',' << wallMs << ',' << wallMs << ',' << wallMs << endl;
+
+            ocean.profiler = nullptr;
+            profiler.Release();
+        }
+    }
+    cout.rdbuf(stdoutStream.rdbuf());
+    return 0;
+}
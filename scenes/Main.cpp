@@ -10,6 +10,10 @@
 #include <camera.h>
 #include <Model.h>
 #include <ocean.h>
+#include <oceanBuoyancy.h>
+#include <gpuProfiler.h>
+#include <cpuProfiler.h>
+#include <chrono>
 
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw.h>
@@ -25,7 +29,7 @@ void load_VAO_VBO(unsigned int* vao, unsigned int* vbo, const float* vertices, c
 unsigned int loadCubemap(vector<std::string> faces);
 void load_Skybox(unsigned int* vao, unsigned int* vbo, unsigned int* cube_tex, vector<std::string> names);
 float getShaderUniformFloat(const Shader& shader, const std::string& uniformName, float defaultValue);
-void ShowTextureSettingsWindow(OceanFFTGenerator& oceanSettings, ComputeShader& spectrum, ComputeShader& conjugate);
+void ShowTextureSettingsWindow(OceanFFTGenerator& oceanSettings);
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
@@ -45,6 +49,11 @@ float lastY = 600.0 / 2.0;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 unsigned int planeVAO;
+// floating debris driven by the CPU height queries, spawned from the per-frame window
+OceanBuoyancy debris;
+double debrisStepMs = 0.0;
+// GPU time of the ocean passes and the render passes below, read back a few frames late
+GpuProfiler gpuProfiler;
 
 
 
@@ -55,10 +64,9 @@ std::vector<Layer> layers;
 
 
 
-void DrawPerFrameSettings(
-    ComputeShader& time_evolution,
-    ComputeShader& normalizeFFT)
+void DrawPerFrameSettings(OceanFFTGenerator& ocean)
 {
+    perFrameParameters& frame = ocean.frame;
     ImGui::SetNextWindowSize(ImVec2(350, 300), ImGuiCond_Once);
     if (!ImGui::Begin("Per Frame Parameters")) {
         ImGui::End();
@@ -67,57 +75,150 @@ void DrawPerFrameSettings(
 
     // === Speed of the Simulation ===
     if (ImGui::CollapsingHeader("Speed of the Simulation", ImGuiTreeNodeFlags_DefaultOpen)) {
-        static int speed = 1;
-        static float repeatTime = 200.0f;
-
-        if (ImGui::SliderInt("Speed", &speed, 0, 10)) {
-            time_evolution.use();
-            time_evolution.setInt("speed", speed);
-        }
-
-        if (ImGui::SliderFloat("Repeat Time", &repeatTime, 1.0f, 200.0f, "%.1f")) {
-            time_evolution.use();
-            time_evolution.setFloat("RepeatTime", repeatTime);
-        }
+        ImGui::SliderInt("Speed", &frame.speed, 0, 10);
+        ImGui::SliderFloat("Repeat Time", &frame.repeatTime, 1.0f, 200.0f, "%.1f");
     }
 
     // === Foam Simulation Parameters ===
     if (ImGui::CollapsingHeader("Foam Simulation Parameters", ImGuiTreeNodeFlags_DefaultOpen)) {
-        static glm::vec2 lambda = glm::vec2(1.0f, 1.0f);
-        static float foamDecayRate = 0.0175f;
-        static float foamBias = 0.85f;
-        static float foamThreshold = 0.0f;
-        static float foamAdd = 0.01f;
-
-        if (ImGui::SliderFloat2("Lambda", glm::value_ptr(lambda), 0.0f, 5.0f, "%.2f")) {
-            normalizeFFT.use();
-            normalizeFFT.setVec2("_Lambda", lambda);
-        }
+        ImGui::SliderFloat2("Lambda", glm::value_ptr(frame.lambda), 0.0f, 5.0f, "%.2f");
+        ImGui::SliderFloat("Foam Decay Rate", &frame.foamDecayRate, 0.0f, 1.0f, "%.4f");
+        ImGui::SliderFloat("Foam Bias", &frame.foamBias, -1.0f, 1.0f, "%.2f");
+        ImGui::SliderFloat("Foam Threshold", &frame.foamThreshold, 0.0f, 1.0f, "%.2f");
+        ImGui::SliderFloat("Foam Add", &frame.foamAdd, 0.0f, 0.1f, "%.3f");
+    }
 
-        if (ImGui::SliderFloat("Foam Decay Rate", &foamDecayRate, 0.0f, 1.0f, "%.4f")) {
-            normalizeFFT.use();
-            normalizeFFT.setFloat("_FoamDecayRate", foamDecayRate);
+    // === Cascade Update Rates ===
+    if (ImGui::CollapsingHeader("Cascade Update Rates")) {
+        const char* rateNames[] = { "Every frame", "Every 2nd frame", "Every 4th frame", "Every 8th frame" };
+        for (int i = 0; i < ocean.TextureCount() && i < MAX_CASCADES; ++i) {
+            int rate = 0;
+            while ((1 << rate) < frame.updateInterval[i] && rate < 3) ++rate;
+            ImGui::PushID(i);
+            if (ImGui::Combo(("Cascade " + std::to_string(i + 1)).c_str(), &rate, rateNames, IM_ARRAYSIZE(rateNames)))
+                frame.updateInterval[i] = 1 << rate;
+            ImGui::PopID();
         }
+        static ScheduleBenchmark benchmark = { 0, 0.0, 0.0 };
+        if (ImGui::Button("Benchmark Schedule"))
+            benchmark = ocean.BenchmarkSchedule((float)glfwGetTime());
+        if (benchmark.frames > 0)
+            ImGui::Text("%.3f ms/frame scheduled, %.3f ms/frame full rate", benchmark.scheduledMs, benchmark.fullRateMs);
+    }
 
-        if (ImGui::SliderFloat("Foam Bias", &foamBias, -1.0f, 1.0f, "%.2f")) {
-            normalizeFFT.use();
-            normalizeFFT.setFloat("_FoamBias", foamBias);
+    // === Height Query ===
+    if (ImGui::CollapsingHeader("Height Query")) {
+        const OceanHeightField& field = ocean.HeightField();
+        if (field.Ready()) {
+            glm::vec2 position(camera.Position.x, camera.Position.z);
+            float height;
+            ocean.SampleHeight(&position, &height, 1);
+            ImGui::Text("Water height below camera: %.2f", height);
+            ImGui::Text("Copy from t = %.2f s (%.0f ms old)", field.time, (glfwGetTime() - field.time) * 1000.0);
         }
+        else
+            ImGui::Text("Waiting for the first readback");
+    }
 
-        if (ImGui::SliderFloat("Foam Threshold", &foamThreshold, 0.0f, 1.0f, "%.2f")) {
-            normalizeFFT.use();
-            normalizeFFT.setFloat("_FoamThreshold", foamThreshold);
+    // === Floating Debris ===
+    if (ImGui::CollapsingHeader("Floating Debris")) {
+        static int debrisCount = 10000;
+        ImGui::SliderInt("Bodies", &debrisCount, 100, 50000);
+        if (ImGui::Button("Spawn Debris")) {
+            // 1 m crates, a probe at each bottom corner, on a grid around the camera
+            const std::vector<OceanBuoyancy::Probe> probes = {
+                { glm::vec3(-0.4f, -0.3f, -0.4f), 0.25f }, { glm::vec3(0.4f, -0.3f, -0.4f), 0.25f },
+                { glm::vec3(-0.4f, -0.3f, 0.4f), 0.25f }, { glm::vec3(0.4f, -0.3f, 0.4f), 0.25f } };
+            debris.Clear();
+            int side = (int)ceil(sqrt((double)debrisCount));
+            for (int i = 0; i < debrisCount; ++i)
+                debris.AddBody(glm::vec3(camera.Position.x + (i % side - side / 2) * 3.0f, 1.0f,
+                    camera.Position.z + (i / side - side / 2) * 3.0f), 60.0f, 0.7f, probes);
         }
+        ImGui::SameLine();
+        if (ImGui::Button("Clear"))
+            debris.Clear();
+        if (debris.BodyCount() > 0)
+            ImGui::Text("%d bodies, %d probes, %.2f ms/step", debris.BodyCount(), debris.ProbeCount(), debrisStepMs);
+    }
 
-        if (ImGui::SliderFloat("Foam Add", &foamAdd, 0.0f, 0.1f, "%.3f")) {
-            normalizeFFT.use();
-            normalizeFFT.setFloat("_FoamAdd", foamAdd);
-        }
+    // === Baked Playback ===
+    if (ImGui::CollapsingHeader("Baked Playback")) {
+        static float bakeRate = 10.0f;
+        const std::string sequencePath = fileFinder::getPath("ocean.oseq");
+        ImGui::SliderFloat("Bake Frame Rate", &bakeRate, 1.0f, 30.0f, "%.0f fps");
+        double rawBytes = 0;
+        for (int i = 0; i < ocean.TextureCount(); ++i)
+            rawBytes += OceanSequence::CascadeWords(ocean.CascadeSize(i)) * 2.0;
+        ImGui::Text("%d frames, %.0f MB before compression", (int)ceil(frame.repeatTime * bakeRate),
+            ceil(frame.repeatTime * bakeRate) * rawBytes / (1024.0 * 1024.0));
+        if (ImGui::Button("Bake Sequence") && ocean.BakeSequence(sequencePath, bakeRate))
+            ocean.LoadSequence(sequencePath);
+        ImGui::SameLine();
+        if (ImGui::Button("Load Sequence"))
+            ocean.LoadSequence(sequencePath);
+        if (ocean.HasSequence())
+            ImGui::Checkbox("Play Baked Sequence", &ocean.playSequence);
+    }
+
+    ImGui::End();
+}
+void DrawGpuProfiler(GpuProfiler& profiler)
+{
+    ImGui::SetNextWindowSize(ImVec2(420, 300), ImGuiCond_Once);
+    if (!ImGui::Begin("GPU Profiler")) {
+        ImGui::End();
+        return;
     }
+    ImGui::Checkbox("Record", &profiler.enabled);
+    ImGui::SameLine();
+    static std::string written;
+    if (ImGui::Button("Write CSV")) {
+        const std::string path = fileFinder::getPath("gpu_profile.csv");
+        written = profiler.WriteCSV(path) ? "wrote " + path : "could not write " + path;
+    }
+    if (!written.empty())
+        ImGui::TextUnformatted(written.c_str());
+    ImGui::Text("last %d frames, %d not recorded (queries still in flight)", GpuProfiler::HISTORY, profiler.DroppedFrames());
+#if OCEAN_CPU_PROFILE
+    // CPU side: startup and every frame's phases since the last write, for chrome://tracing
+    ImGui::Checkbox("Record CPU Trace", &CpuProfiler::Get().recording);
+    ImGui::SameLine();
+    static std::string traceWritten;
+    if (ImGui::Button("Write Chrome Trace")) {
+        const std::string path = fileFinder::getPath("cpu_trace.json");
+        traceWritten = CpuProfiler::Get().WriteTrace(path) ? "wrote " + path : "could not write " + path;
+    }
+    ImGui::Text("%zu CPU events buffered", CpuProfiler::Get().EventCount());
+    if (!traceWritten.empty())
+        ImGui::TextUnformatted(traceWritten.c_str());
+#endif
 
+    if (ImGui::BeginTable("scopes", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV)) {
+        ImGui::TableSetupColumn("Scope");
+        ImGui::TableSetupColumn("Last ms");
+        ImGui::TableSetupColumn("Min ms");
+        ImGui::TableSetupColumn("Avg ms");
+        ImGui::TableSetupColumn("P99 ms");
+        ImGui::TableHeadersRow();
+        for (const GpuProfiler::Stat& stat : profiler.Stats()) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(stat.name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stat.lastMs);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stat.minMs);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stat.avgMs);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stat.p99Ms);
+        }
+        ImGui::EndTable();
+    }
     ImGui::End();
 }
-void DrawOceanSurfaceSettings(Shader& oceanShader)
+void DrawOceanSurfaceSettings(Shader& oceanShader, OceanFFTGenerator& ocean)
 {
     ImGui::SetNextWindowSize(ImVec2(400, 400), ImGuiCond_Once);
     if (!ImGui::Begin("Ocean Surface Appearance")) {
@@ -142,6 +243,7 @@ void DrawOceanSurfaceSettings(Shader& oceanShader)
         static float scatterShadowStrength = 0.5f;
         static float displacementDepthAttenuation = 1.0f;
         static float underwaterFadeStrength = 2.0f;
+        static float targetEdgePixels = 16.0f;
 
         auto setColor = [&](const char* label, glm::vec3& value, const char* uniform) {
             if (ImGui::ColorEdit3(label, glm::value_ptr(value))) {
@@ -172,7 +274,18 @@ void DrawOceanSurfaceSettings(Shader& oceanShader)
         setSlider("Scatter Strength", scatterStrength, 0.0f, 10.0f, "_ScatterStrength");
         setSlider("Scatter Shadow Strength", scatterShadowStrength, 0.0f, 1.0f, "_ScatterShadowStrength");
         setSlider("Displacement Depth Attenuation", displacementDepthAttenuation, 0.0f, 5.0f, "_DisplacementDepthAttenuation");
+        // the culling bounds grow with it
+        ocean.displacementScale = displacementDepthAttenuation;
         setSlider("Underwater Fade Strength", underwaterFadeStrength, 0.0f, 5.0f, "_UnderwaterFadeStrength");
+        // oceanFFT.tcs tessellates to this edge length on screen, whatever the resolution or zoom
+        setSlider("Triangle Edge (Pixels)", targetEdgePixels, 2.0f, 64.0f, "_TargetEdgePixels");
+
+        // off draws every patch, to compare against
+        ImGui::Checkbox("Cull Patches", &ocean.cullPatches);
+        // opt-in: the far rings curve down past the horizon (oceanFFT.tes) and get culled there
+        bool earthCurvature = ocean.earthRadius > 0.0f;
+        if (ImGui::Checkbox("Earth Curvature", &earthCurvature))
+            ocean.earthRadius = earthCurvature ? 6371000.0f : 0.0f;
     }
 
     ImGui::End();
@@ -207,6 +320,7 @@ int main()
     }
 
     glEnable(GL_DEPTH_TEST);
+    CPU_PROFILE_BEGIN(startup, "startup");
 
     Shader textureLoad("vTexture.vert", "vTexture.frag");
     Shader skyboxShader("skybox.vert", "skybox.frag");
@@ -241,19 +355,16 @@ int main()
     skyboxShader.use();
     skyboxShader.setVec3("sunDirection", sunDirection);
     skyboxShader.setVec3("sunColor", sunColor);
+    CPU_PROFILE_BEGIN(oceanSetup, "ocean setup");
     OceanFFTGenerator oceanSettings(layers);
-    ComputeShader spectrum("Spectrum_INIT.cps");
-    ComputeShader conjugate("SpectrumConjugate.cps");
+    oceanSettings.profiler = &gpuProfiler;
     
-    oceanSettings.CalculateSpectrum(spectrum, conjugate);
-    oceanSettings.createFFTWaterPlane(100);
-
-    ComputeShader timeEvolutionShader("time_evolution.cps");
-    timeEvolutionShader.use();
-
-
-    ComputeShader horizontalFFT("horizontalFFT.cps");
-    ComputeShader verticalFFT("verticalFFT.cps");
+    oceanSettings.CalculateSpectrum();
+    oceanSettings.EnableHeightQueries();
+    oceanSettings.createClipmap();
+    // the clipmap reaches tens of kilometres, the far plane follows it
+    const float farPlane = glm::max(5000.0f, oceanSettings.ClipmapRadius() * 1.5f);
+    CPU_PROFILE_END(oceanSetup);
 
     Shader oceanShader("oceanFFT.vert", "oceanFFT.frag", nullptr, "oceanFFT.tcs", "oceanFFT.tes");
     oceanShader.use();
@@ -262,20 +373,15 @@ int main()
     oceanShader.setVec3("_lightDir",sunDirection);
     oceanShader.setInt("_EnvironmentMap",2);
     oceanShader.setInt("_SceneColor", 3);
+    oceanShader.setFloat("_FarPlane", farPlane);
 
-    oceanShader.setInt("_DisplacementTextures", 0);
-    oceanShader.setInt("_SlopeTextures", 1);
-
-    ComputeShader normalizeFFT("fftNormalize.cps");
-    normalizeFFT.use();
-
-
+    oceanSettings.setSamplers(oceanShader, "_DisplacementTextures", "_SlopeTextures");
 
     Shader screenShader("PP.vert","PP.frag");
     screenShader.use();
     screenShader.setInt("screenTexture",0);
     screenShader.setInt("depthTexture", 1);
-    screenShader.setInt("DisplacementTextures", 2);
+    oceanSettings.setSamplers(screenShader, "DisplacementTextures");
     
   
     unsigned int framebuffer;
@@ -307,9 +413,11 @@ int main()
     oceanShader.use();
     
 
+    CPU_PROFILE_END(startup);
     int fCounter = 0;
     while (!glfwWindowShouldClose(window))
     {
+        CPU_PROFILE_SCOPE("frame");
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
@@ -318,22 +426,32 @@ int main()
             fCounter = 0;
         }
 
+        CPU_PROFILE_BEGIN(input, "input");
         processInput(window);
+        CPU_PROFILE_END(input);
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        gpuProfiler.BeginFrame();
 
         // === Ocean Spectrum Update ===
-        timeEvolutionShader.use();
-        timeEvolutionShader.setFloat("time", currentFrame);
-        oceanSettings.EvolveSpectrum(timeEvolutionShader);
-        oceanSettings.IFFT(horizontalFFT, verticalFFT);
-        oceanSettings.AssembleTextures(normalizeFFT);
+        {
+            CPU_PROFILE_SCOPE("ocean dispatch");
+            GpuProfiler::Scope scope(&gpuProfiler, "ocean update");
+            oceanSettings.Update(currentFrame);
+        }
+        if (debris.BodyCount() > 0 && oceanSettings.HeightField().Ready()) {
+            CPU_PROFILE_SCOPE("debris step");
+            auto stepStart = std::chrono::steady_clock::now();
+            debris.Step(oceanSettings.HeightField(), glm::min(deltaTime, 1.0f / 30.0f));
+            debrisStepMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stepStart).count();
+        }
 
         // === Main Render Pass ===
+        CPU_PROFILE_BEGIN(uniforms, "uniform upload");
         glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
         glEnable(GL_DEPTH_TEST);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / SCR_HEIGHT, 0.1f, 5000.0f);
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / SCR_HEIGHT, 0.1f, farPlane);
         glm::mat4 view = camera.GetViewMatrix();
         glm::mat4 model = glm::mat4(1.0f);
 
@@ -354,13 +472,20 @@ int main()
         oceanShader.setMat4("projection", projection);
         oceanShader.setVec3("cameraPos", camera.Position);
         oceanShader.setInt("_TextureZ",oceanSettings.TextureCount());
+        oceanSettings.setTileSizes(oceanShader);
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        oceanShader.setFloat("_ViewportHeight", (float)framebufferHeight);
 
        
 
 
    
 
+        CPU_PROFILE_END(uniforms);
         // Skybox
+        CPU_PROFILE_BEGIN(draws, "draw submission");
+        int skyboxScope = gpuProfiler.Begin("skybox");
         glDepthFunc(GL_LEQUAL);
         skyboxShader.use();
          auto skybox_view = glm::mat4(glm::mat3(camera.GetViewMatrix())); // remove translation from the view matrix
@@ -373,8 +498,10 @@ int main()
         glDrawArrays(GL_TRIANGLES, 0, 36);
         glBindVertexArray(0);
         glDepthFunc(GL_LESS);
+        gpuProfiler.End(skyboxScope);
 
 
+        int oceanScope = gpuProfiler.Begin("ocean draw");
         oceanShader.use();
         model = glm::mat4();
         model = glm::scale(model, glm::vec3(1, 1, 1));
@@ -390,19 +517,22 @@ int main()
         glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
         glActiveTexture(GL_TEXTURE3);
         glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
-        oceanSettings.RenderOcean();
+        oceanSettings.RenderOcean(oceanShader, camera.Position, projection * view * model);
+        gpuProfiler.End(oceanScope);
 
 
         // now bind back to default framebuffer and draw a quad plane with the attached framebuffer color texture
 
         // Final screen render (postprocess pass)
 
+        int postScope = gpuProfiler.Begin("post-process");
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
         glDisable(GL_DEPTH_TEST);
         glClear(GL_COLOR_BUFFER_BIT);
         screenShader.use();
         screenShader.setVec3("cameraPos", camera.Position);
         screenShader.setInt("_TextureZ", oceanSettings.TextureCount());
+        screenShader.setFloat("farPlane", farPlane);
 
         screenShader.setMat4("invViewProj", glm::inverse(projection * view));
         
@@ -412,29 +542,40 @@ int main()
     
         glActiveTexture(GL_TEXTURE1);
       glBindTexture(GL_TEXTURE_2D, depthTexture);
-      glActiveTexture(GL_TEXTURE2);
-      glBindTexture(GL_TEXTURE_2D, oceanSettings.DisplacementTexture());
         renderQuad();
+        gpuProfiler.End(postScope);
+        CPU_PROFILE_END(draws);
 
         // === IMGUI UI ===
+        CPU_PROFILE_BEGIN(imguiBuild, "imgui build");
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
         if (cursorEnabled) {
-            DrawPerFrameSettings(timeEvolutionShader,normalizeFFT);
-            DrawOceanSurfaceSettings(oceanShader);
+            DrawPerFrameSettings(oceanSettings);
+            DrawOceanSurfaceSettings(oceanShader, oceanSettings);
         }
-        ShowTextureSettingsWindow(oceanSettings,spectrum,conjugate);
+        ShowTextureSettingsWindow(oceanSettings);
+        DrawGpuProfiler(gpuProfiler);
 
         ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        CPU_PROFILE_END(imguiBuild);
+        {
+            CPU_PROFILE_SCOPE("imgui render");
+            GpuProfiler::Scope scope(&gpuProfiler, "imgui");
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
 
-        glfwSwapBuffers(window);
+        {
+            CPU_PROFILE_SCOPE("swap");
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
     }
 
     // Cleanup
+    gpuProfiler.Release();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -461,7 +602,7 @@ void ShowSpectrumSettings(DisplaySpectrumSettings& settings, const char* labelPr
 
 
 
-void ShowTextureSettingsWindow(OceanFFTGenerator& oceanSettings, ComputeShader& spectrum,ComputeShader& conjugate)
+void ShowTextureSettingsWindow(OceanFFTGenerator& oceanSettings)
 {
     static int sliderValue = 4;
     static int selectedTextureIdx = 2;
@@ -471,6 +612,8 @@ void ShowTextureSettingsWindow(OceanFFTGenerator& oceanSettings, ComputeShader&
     static float highCutoff = 9000.0f;
     static float depth = 20.0f;
     static float gravity = 9.8f;
+    static OceanPrecision precision;
+    static std::vector<PrecisionMeasurement> measurements;
 
     static const char* textureSizes[] = {
         "2048", "1024", "512", "256", "128", "64", "32", "16"
@@ -499,6 +642,17 @@ void ShowTextureSettingsWindow(OceanFFTGenerator& oceanSettings, ComputeShader&
         ImGui::EndCombo();
     }
 
+    ImGui::Checkbox("Shared Memory FFT", &oceanSettings.useStockhamFFT);
+    ImGui::Checkbox("Fused Evolve/Assemble", &oceanSettings.useFusedFFT);
+    static FusionBenchmark fusion = { 0, 0.0, 0.0 };
+    ImGui::SameLine();
+    if (ImGui::Button("Benchmark Fusion"))
+        fusion = oceanSettings.BenchmarkFusion(static_cast<float>(glfwGetTime()));
+    if (fusion.frames > 0)
+        ImGui::Text("separate %.3f ms, fused %.3f ms", fusion.separateMs, fusion.fusedMs);
+    ImGui::Checkbox("Double Buffered Outputs", &oceanSettings.doubleBuffer);
+    ImGui::SliderInt("Mip Levels", &oceanSettings.mipLevels, 0, 8);
+
     // New parameters
     ImGui::SliderInt("Seed", &seed, 0, 1000000);
     ImGui::SliderFloat("Low Cutoff", &lowCutoff, 0.0001f, 9000.0f, "%.4f");
@@ -506,11 +660,58 @@ void ShowTextureSettingsWindow(OceanFFTGenerator& oceanSettings, ComputeShader&
     ImGui::SliderFloat("Depth", &depth, 2.0f, 20.0f);
     ImGui::SliderFloat("Gravity", &gravity, 0.0f, 20.0f);
 
+    // FP32 storage per stage, everything else is FP16
+    if (ImGui::CollapsingHeader("Precision")) {
+        ImGui::Checkbox("FP32 Initial Spectrum", &precision.initialSpectrum);
+        ImGui::Checkbox("FP32 Evolved Spectrum", &precision.evolvedSpectrum);
+        ImGui::Checkbox("FP32 FFT Scratch", &precision.fftScratch);
+        ImGui::Checkbox("FP32 Outputs", &precision.outputs);
+        ImGui::Text("%.1f MB/frame", oceanSettings.FrameBandwidth(oceanSettings.Precision()) / (1024.0 * 1024.0));
+
+        if (!measurements.empty() && ImGui::BeginTable("PrecisionReport", 5, ImGuiTableFlags_Borders)) {
+            ImGui::TableSetupColumn("Init/Evo/Scr/Out");
+            ImGui::TableSetupColumn("MB/frame");
+            ImGui::TableSetupColumn("Disp RMS");
+            ImGui::TableSetupColumn("Disp Max");
+            ImGui::TableSetupColumn("Slope RMS");
+            ImGui::TableHeadersRow();
+            for (const PrecisionMeasurement& result : measurements) {
+                const OceanPrecision& p = result.precision;
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%d/%d/%d/%d", p.initialSpectrum ? 32 : 16, p.evolvedSpectrum ? 32 : 16,
+                    p.fftScratch ? 32 : 16, p.outputs ? 32 : 16);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", result.megabytesPerFrame);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2e", result.displacementRMS);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2e", result.displacementMax);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2e", result.slopeRMS);
+            }
+            ImGui::EndTable();
+        }
+    }
+
     // Show UI for each layer
     for (int i = 0; i < sliderValue; ++i) {
         std::string layerLabel = "Layer " + std::to_string(i + 1);
         if (ImGui::CollapsingHeader(layerLabel.c_str())) {
             ImGui::InputInt(("Domain Size##" + std::to_string(i)).c_str(), &layers[i].DomainSize);
+            // per cascade FFT size, "Global" follows Texture Size
+            int& layerSize = layers[i].TextureSize;
+            std::string layerSizeLabel = layerSize > 0 ? std::to_string(layerSize) : "Global";
+            if (ImGui::BeginCombo(("FFT Size##" + std::to_string(i)).c_str(), layerSizeLabel.c_str())) {
+                if (ImGui::Selectable("Global", layerSize == 0))
+                    layerSize = 0;
+                for (int s = 0; s < numTextureSizes; s++) {
+                    int size = std::stoi(textureSizes[s]);
+                    if (ImGui::Selectable(textureSizes[s], layerSize == size))
+                        layerSize = size;
+                }
+                ImGui::EndCombo();
+            }
             ShowSpectrumSettings(layers[i].spec1, ("Layer" + std::to_string(i) + "_Spec1").c_str(), "Spectrum 1");
             ShowSpectrumSettings(layers[i].spec2, ("Layer" + std::to_string(i) + "_Spec2").c_str(), "Spectrum 2");
         }
@@ -522,9 +723,8 @@ void ShowTextureSettingsWindow(OceanFFTGenerator& oceanSettings, ComputeShader&
 
     // Position to bottom right
     float windowWidth = ImGui::GetWindowContentRegionMax().x;
-    ImGui::SetCursorPosX(windowWidth - buttonWidth - padding);
     
-    if (ImGui::Button("Bake", ImVec2(buttonWidth, 0))) {
+    auto currentParameters = [&]() {
         perChangeParameters parameters;
         parameters.TextureSize = std::stoi(textureSizes[selectedTextureIdx]);
         parameters.TextureCount = sliderValue;
@@ -534,9 +734,19 @@ void ShowTextureSettingsWindow(OceanFFTGenerator& oceanSettings, ComputeShader&
         parameters.Depth = depth;
         parameters.Gravity = gravity;
         parameters.layers = layers; 
+        parameters.precision = precision;
+        return parameters;
+    };
 
-       oceanSettings. InitialBake(parameters);
-       oceanSettings.CalculateSpectrum(spectrum, conjugate);
+    // rebakes every precision policy against FP32 and leaves the current settings baked
+    ImGui::SetCursorPosX(windowWidth - 2 * buttonWidth - 2 * padding);
+    if (ImGui::Button("Measure", ImVec2(buttonWidth, 0)))
+        measurements = oceanSettings.MeasurePrecision(currentParameters(), static_cast<float>(glfwGetTime()));
+    ImGui::SameLine();
+    ImGui::SetCursorPosX(windowWidth - buttonWidth - padding);
+    if (ImGui::Button("Bake", ImVec2(buttonWidth, 0))) {
+       oceanSettings. InitialBake(currentParameters());
+       oceanSettings.CalculateSpectrum();
     }
     ImGui::End();
 }
@@ -679,6 +889,7 @@ unsigned int loadTexture(char const* path)
 }
 unsigned int loadCubemap(std::vector<std::string> faces)
 {
+    CPU_PROFILE_SCOPE("loadCubemap");
     unsigned int textureID;
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
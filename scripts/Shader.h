@@ -11,6 +11,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <fileFinder.h>
+#include <cpuProfiler.h>
 
 class ShaderBase
 {
@@ -25,6 +26,31 @@ public:
     ~ShaderBase() {
    //     if (ID) glDeleteProgram(ID);
     }
+    // some of the shaders are saved with a UTF-8 BOM, which Mesa's preprocessor rejects
+    static void StripByteOrderMark(std::string& code) {
+        if (code.compare(0, 3, "\xEF\xBB\xBF") == 0)
+            code.erase(0, 3);
+    }
+    // GLSL has no #include: every `#include "file"` line is replaced by that file from shaders/,
+    // so stages can share functions (oceanCascade.glsl)
+    static void ResolveIncludes(std::string& code) {
+        size_t at = 0;
+        while ((at = code.find("#include \"", at)) != std::string::npos) {
+            size_t nameStart = at + 10;
+            size_t nameEnd = code.find('"', nameStart);
+            size_t lineEnd = code.find('\n', at);
+            if (nameEnd == std::string::npos || (lineEnd != std::string::npos && nameEnd > lineEnd))
+                break;
+            std::ifstream file(fileFinder::getShaderPath(code.substr(nameStart, nameEnd - nameStart)));
+            std::stringstream stream;
+            stream << file.rdbuf();
+            std::string included = stream.str();
+            StripByteOrderMark(included);
+            ResolveIncludes(included);
+            code.replace(at, (lineEnd == std::string::npos ? code.size() : lineEnd) - at, included);
+            at += included.size();
+        }
+    }
 
     // utility uniform functions
    // ------------------------------------------------------------------------
@@ -96,6 +122,7 @@ public:
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const char* TControlPath = nullptr, const char* TEvaluationPath = nullptr)
     {
+        CPU_PROFILE_SCOPE_DETAIL("shader compile", fragmentPath);
         std::string vertexCode, fragmentCode, geometryCode, tControlCode, tEvaluationCode;
 
         try {
@@ -189,7 +216,10 @@ private:
         std::stringstream shaderStream;
         shaderStream << shaderFile.rdbuf();
         shaderFile.close();
-        return shaderStream.str();
+        std::string code = shaderStream.str();
+        StripByteOrderMark(code);
+        ResolveIncludes(code);
+        return code;
     }
 
     const char* getShaderTypeName(GLenum shaderType) {
@@ -218,8 +248,10 @@ public:
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
 
-    ComputeShader(const char* computePath)
+    // defines (e.g. "#define FFT_SIZE 512\n") are inserted right after the #version line
+    ComputeShader(const char* computePath, const std::string& defines = "")
     {
+        CPU_PROFILE_SCOPE_DETAIL("shader compile", computePath);
         // 1. retrieve the vertex/fragment source code from filePath
         std::string computeCode;
         std::ifstream cShaderFile;
@@ -237,6 +269,12 @@ public:
             cShaderFile.close();
             // convert stream into string
             computeCode = cShaderStream.str();
+            StripByteOrderMark(computeCode);
+            ResolveIncludes(computeCode);
+            if (!defines.empty()) {
+                size_t versionEnd = computeCode.find('\n', computeCode.find("#version"));
+                computeCode.insert(versionEnd == std::string::npos ? computeCode.size() : versionEnd + 1, defines);
+            }
         }
         catch (std::ifstream::failure& e)
         {
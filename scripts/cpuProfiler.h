@@ -0,0 +1,136 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// CPU scope timing for chrome://tracing (or ui.perfetto.dev). CPU_PROFILE_SCOPE("name") times the
+// rest of the enclosing block as one complete ("X") event on the calling thread;
+// CPU_PROFILE_BEGIN(span, "name") ... CPU_PROFILE_END(span) does the same for a stretch of a block.
+// CpuProfiler::Get().WriteTrace writes everything recorded so far as Chrome trace JSON.
+// Build with OCEAN_CPU_PROFILE 0 and the macros expand to nothing. Compiled in, a scope costs two
+// clock reads and a locked push_back while recording and one branch while not.
+#ifndef OCEAN_CPU_PROFILE
+#define OCEAN_CPU_PROFILE 1
+#endif
+
+class CpuProfiler
+{
+public:
+    // recording stops by itself once this many events are buffered, WriteTrace empties the buffer
+    static const size_t MAX_EVENTS = 1 << 20;
+
+    static CpuProfiler& Get() {
+        static CpuProfiler profiler;
+        return profiler;
+    }
+
+    class Scope {
+    public:
+        // name has to outlive the profiler (a literal), detail is copied
+        explicit Scope(const char* name, const char* detail = nullptr) : name(name), detail(detail) {
+            if (Get().recording)
+                start = Get().Now();
+        }
+        ~Scope() {
+            End();
+        }
+        // ends the event before the block does, for phases that don't have a block of their own
+        void End() {
+            if (start >= 0 && Get().recording)
+                Get().Record(name, detail, start, Get().Now() - start);
+            start = -1;
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        const char* name;
+        const char* detail;
+        int64_t start = -1;
+    };
+
+    bool recording = true;
+
+    size_t EventCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return events.size();
+    }
+
+    // writes the buffered events and drops them, false when the file can't be written
+    bool WriteTrace(const std::string& path) {
+        std::vector<Event> written;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            written.swap(events);
+        }
+        std::ofstream file(path, std::ios::trunc);
+        if (!file)
+            return false;
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        for (size_t i = 0; i < written.size(); ++i) {
+            const Event& event = written[i];
+            file << "{\"name\":\"" << Escape(event.name) << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+                 << ",\"ts\":" << event.start << ",\"dur\":" << event.duration;
+            if (!event.detail.empty())
+                file << ",\"args\":{\"detail\":\"" << Escape(event.detail) << "\"}";
+            file << (i + 1 < written.size() ? "},\n" : "}\n");
+        }
+        file << "]}\n";
+        return (bool)file;
+    }
+
+private:
+    struct Event {
+        const char* name;
+        std::string detail;
+        int64_t start, duration;   // microseconds since the profiler was created
+        uint32_t thread;
+    };
+
+    CpuProfiler() : origin(std::chrono::steady_clock::now()) {}
+
+    int64_t Now() const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+    }
+    void Record(const char* name, const char* detail, int64_t start, int64_t duration) {
+        uint32_t thread = (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id());
+        std::lock_guard<std::mutex> lock(mutex);
+        if (events.size() >= MAX_EVENTS) {
+            recording = false;
+            return;
+        }
+        events.push_back({ name, detail ? detail : "", start, duration, thread });
+    }
+    static std::string Escape(const std::string& text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            if ((unsigned char)c >= 0x20)
+                escaped += c;
+        }
+        return escaped;
+    }
+
+    std::chrono::steady_clock::time_point origin;
+    std::mutex mutex;
+    std::vector<Event> events;
+};
+
+#define CPU_PROFILE_CONCAT_(a, b) a##b
+#define CPU_PROFILE_CONCAT(a, b) CPU_PROFILE_CONCAT_(a, b)
+#if OCEAN_CPU_PROFILE
+#define CPU_PROFILE_SCOPE(name) CpuProfiler::Scope CPU_PROFILE_CONCAT(cpuProfileScope, __LINE__)(name)
+#define CPU_PROFILE_SCOPE_DETAIL(name, detail) CpuProfiler::Scope CPU_PROFILE_CONCAT(cpuProfileScope, __LINE__)(name, detail)
+#define CPU_PROFILE_BEGIN(span, name) CpuProfiler::Scope span(name)
+#define CPU_PROFILE_END(span) span.End()
+#else
+#define CPU_PROFILE_SCOPE(name) ((void)0)
+#define CPU_PROFILE_SCOPE_DETAIL(name, detail) ((void)0)
+#define CPU_PROFILE_BEGIN(span, name) ((void)0)
+#define CPU_PROFILE_END(span) ((void)0)
+#endif
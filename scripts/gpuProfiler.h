@@ -0,0 +1,216 @@
+#pragma once
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+// GPU time of named scopes, from GL_TIMESTAMP queries around them. Every frame records into one
+// of FRAMES_IN_FLIGHT query pools; BeginFrame reads back the pools whose last query is available
+// and never waits, so results show up a few frames late. A frame whose pool is still in flight
+// is not recorded. Scopes may nest, a name used several times in a frame (one per cascade, say)
+// adds up. The last HISTORY frames are kept for Stats and WriteCSV.
+class GpuProfiler
+{
+public:
+    static const int FRAMES_IN_FLIGHT = 4;
+    static const int HISTORY = 512;
+
+    struct Stat {
+        std::string name;
+        int samples = 0;   // frames of the history the scope ran in
+        float lastMs = 0, minMs = 0, avgMs = 0, p99Ms = 0;
+    };
+
+    // closes its scope when it goes out of scope, a null profiler records nothing
+    class Scope {
+    public:
+        Scope(GpuProfiler* profiler, const char* name) : profiler(profiler) {
+            mark = profiler ? profiler->Begin(name) : -1;
+        }
+        ~Scope() {
+            if (profiler) profiler->End(mark);
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        GpuProfiler* profiler;
+        int mark;
+    };
+
+    bool enabled = true;
+
+    // deletes the queries, needs the context current (the destructor leaves them to the context)
+    void Release() {
+        for (Pool& pool : pools) {
+            if (!pool.queries.empty())
+                glDeleteQueries((GLsizei)pool.queries.size(), pool.queries.data());
+            pool = Pool();
+        }
+    }
+
+    // once per frame, before the first scope
+    void BeginFrame() {
+        for (int k = 1; k <= FRAMES_IN_FLIGHT; ++k) {
+            Pool& pool = pools[(current + k) % FRAMES_IN_FLIGHT];
+            if (pool.pending && Available(pool))
+                Collect(pool);
+        }
+        current = (current + 1) % FRAMES_IN_FLIGHT;
+        Pool& pool = pools[current];
+        recording = enabled && !pool.pending;
+        if (enabled && pool.pending)
+            ++dropped;
+        if (!recording)
+            return;
+        pool.marks.clear();
+        pool.used = 0;
+        pool.frame = frame++;
+        pool.pending = true;
+    }
+
+    // returns the mark End takes, -1 when nothing is recorded
+    int Begin(const char* name) {
+        if (!recording)
+            return -1;
+        Pool& pool = pools[current];
+        Mark mark;
+        mark.name = NameIndex(name);
+        mark.begin = NextQuery(pool);
+        glQueryCounter(mark.begin, GL_TIMESTAMP);
+        pool.marks.push_back(mark);
+        return (int)pool.marks.size() - 1;
+    }
+    void End(int mark) {
+        if (!recording || mark < 0)
+            return;
+        Pool& pool = pools[current];
+        pool.marks[mark].end = NextQuery(pool);
+        glQueryCounter(pool.marks[mark].end, GL_TIMESTAMP);
+    }
+
+    std::vector<Stat> Stats() const {
+        std::vector<Stat> stats(names.size());
+        std::vector<float> samples;
+        for (size_t n = 0; n < names.size(); ++n) {
+            Stat& stat = stats[n];
+            stat.name = names[n];
+            samples.clear();
+            for (const FrameTimes& times : history)
+                if (n < times.ms.size() && times.ms[n] >= 0)
+                    samples.push_back(times.ms[n]);
+            stat.samples = (int)samples.size();
+            if (samples.empty())
+                continue;
+            stat.lastMs = samples.back();
+            double sum = 0;
+            for (float ms : samples)
+                sum += ms;
+            stat.avgMs = float(sum / samples.size());
+            std::sort(samples.begin(), samples.end());
+            stat.minMs = samples.front();
+            stat.p99Ms = samples[std::min(samples.size() - 1, (size_t)std::ceil(0.99 * samples.size()) - 1)];
+        }
+        return stats;
+    }
+
+    // one row per recorded frame of the history, one column per scope, empty where it didn't run
+    bool WriteCSV(const std::string& path) const {
+        std::ofstream file(path, std::ios::trunc);
+        if (!file)
+            return false;
+        file << "frame";
+        for (const std::string& name : names)
+            file << ',' << name;
+        file << '\n';
+        for (const FrameTimes& times : history) {
+            file << times.frame;
+            for (size_t n = 0; n < names.size(); ++n) {
+                file << ',';
+                if (n < times.ms.size() && times.ms[n] >= 0)
+                    file << times.ms[n];
+            }
+            file << '\n';
+        }
+        return (bool)file;
+    }
+
+    // frames BeginFrame found their pool still in flight for
+    int DroppedFrames() const { return dropped; }
+
+private:
+    struct Mark {
+        int name = 0;
+        GLuint begin = 0, end = 0;
+    };
+    struct Pool {
+        std::vector<GLuint> queries;
+        int used = 0;
+        std::vector<Mark> marks;
+        uint64_t frame = 0;
+        bool pending = false;
+    };
+    struct FrameTimes {
+        uint64_t frame;
+        std::vector<float> ms;   // per name, -1 when the scope didn't run
+    };
+
+    int NameIndex(const char* name) {
+        auto found = nameIndices.find(name);
+        if (found != nameIndices.end())
+            return found->second;
+        int index = (int)names.size();
+        names.push_back(name);
+        nameIndices[name] = index;
+        return index;
+    }
+    GLuint NextQuery(Pool& pool) {
+        if (pool.used == (int)pool.queries.size()) {
+            // grow the pool in chunks, it settles after the first frames
+            size_t grown = pool.queries.size() + 32;
+            size_t first = pool.queries.size();
+            pool.queries.resize(grown);
+            glGenQueries(GLsizei(grown - first), pool.queries.data() + first);
+        }
+        return pool.queries[pool.used++];
+    }
+    // timestamps land in order, the last one written tells about the whole pool
+    static bool Available(const Pool& pool) {
+        if (pool.used == 0)
+            return true;
+        GLuint available = 0;
+        glGetQueryObjectuiv(pool.queries[pool.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        return available != 0;
+    }
+    void Collect(Pool& pool) {
+        pool.pending = false;
+        FrameTimes times;
+        times.frame = pool.frame;
+        times.ms.assign(names.size(), -1.0f);
+        for (const Mark& mark : pool.marks) {
+            if (mark.end == 0)
+                continue;
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(mark.begin, GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(mark.end, GL_QUERY_RESULT, &end);
+            float& ms = times.ms[mark.name];
+            ms = std::max(ms, 0.0f) + float(double(end - begin) * 1e-6);
+        }
+        history.push_back(std::move(times));
+        if ((int)history.size() > HISTORY)
+            history.pop_front();
+    }
+
+    Pool pools[FRAMES_IN_FLIGHT];
+    int current = 0;
+    bool recording = false;
+    uint64_t frame = 0;
+    int dropped = 0;
+    std::vector<std::string> names;
+    std::map<std::string, int> nameIndices;
+    std::deque<FrameTimes> history;
+};
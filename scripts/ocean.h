@@ -1,9 +1,22 @@
 ﻿#pragma once
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <string>
 #include <vector>
 #include <random>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <Shader.h>
+#include <oceanParameters.h>
+#include <spectrumCache.h>
+#include <oceanSequence.h>
+#include <oceanHeightField.h>
+#include <gpuProfiler.h>
+#include <oceanReference.h>
 
 
 GLuint CreateTextureArray(int width, int height, int depth, GLenum format, bool useMips) {
@@ -18,52 +31,102 @@ GLuint CreateTextureArray(int width, int height, int depth, GLenum format, bool
     glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, format, width, height, depth);
 
     // Set filtering
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,  GL_LINEAR_MIPMAP_LINEAR );
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, useMips ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     // Set wrapping mode
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-    // Anisotropic filtering
-    glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY, 16.0f);
+    // No anisotropic filtering: every read is a textureLod, whose derivatives count as zero, so it
+    // can't help; drivers that still filter with neighbouring lanes' coordinates (llvmpipe in the
+    // TES) displace a vertex shared by two patches differently and the surface cracks.
 
     return textureID; 
 }
 
 
 
-struct DisplaySpectrumSettings {
+// Butterfly tables of the ping-pong FFT, one SSBO per FFT size for the whole process.
+// Entry stage * N + k is { vec2 twiddle; ivec2 indices; } (std430, 16 bytes), see precomputeDiddyFactor.cps.
+// Tables and the precompute program live until exit; a bake at a size seen before costs nothing.
+class ButterflyTables
+{
 public:
-    //   [Range(0, 5)]
-    float scale;
-    float windSpeed;
-    //  [Range(0.0f, 360.0f)]
-    float windDirection;
-    float fetch;
-    //   [Range(0, 1)]
-    float spreadBlend;
-    //  [Range(0, 1)]
-    float swell;
-    float peakEnhancement;
-    float shortWavesFade;
+    static GLuint Get(int size) {
+        std::map<int, GLuint>& tables = Tables();
+        auto found = tables.find(size);
+        if (found != tables.end())
+            return found->second;
+
+        static ComputeShader precompute("precomputeDiddyFactor.cps");
+        int logSize = static_cast<int>(log2(size));
+
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(logSize) * size * 4 * sizeof(GLint), nullptr, GL_STATIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, buffer);
+
+        precompute.use();
+        precompute.setInt("Size", size);
+        glDispatchCompute(logSize, size / 2 / 8, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        tables[size] = buffer;
+        return buffer;
+    }
+private:
+    static std::map<int, GLuint>& Tables() {
+        static std::map<int, GLuint> tables;
+        return tables;
+    }
 };
-struct Layer {
-public:
-    int DomainSize;
-    DisplaySpectrumSettings spec1;
-    DisplaySpectrumSettings spec2;
+
+// bindTextures puts cascade i's displacement at DISPLACEMENT_TEXTURE_UNIT + i and its slope at SLOPE_TEXTURE_UNIT + i
+const int DISPLACEMENT_TEXTURE_UNIT = 4;
+const int SLOPE_TEXTURE_UNIT = DISPLACEMENT_TEXTURE_UNIT + MAX_CASCADES;
+
+// One row of OceanFFTGenerator::MeasurePrecision
+struct PrecisionMeasurement {
+    OceanPrecision precision;
+    double megabytesPerFrame;   // image traffic of EvolveSpectrum + IFFT + AssembleTextures
+    // errors against the all-FP32 bake
+    double displacementRMS;
+    double displacementMax;
+    double slopeRMS;
+    double slopeMax;
+    double foamRMS;
+};
+
+struct ScheduleBenchmark {
+    int frames;
+    double scheduledMs;   // average GPU time of Update per frame
+    double fullRateMs;    // same frames with every interval at 1
+};
+
+struct FusionBenchmark {
+    int frames;
+    double separateMs;    // EvolveSpectrum -> IFFT -> AssembleTextures
+    double fusedMs;       // fused row and column passes where the size allows
 };
-struct perChangeParameters {
-    int TextureSize;
-    int TextureCount;
+
+// One row of OceanFFTGenerator::MeasureAccuracy: a variant at one seed and time against the FP64
+// reference (oceanReference.h). Every stage is checked on its own, its reference is computed from
+// the GPU's output of the stage before, so errors don't carry over from one stage to the next.
+struct AccuracyMeasurement {
+    const char* variant;        // FFT path: "ping-pong", "stockham" or "fused"
+    OceanPrecision precision;
     int seed;
-    float lowCutOff;
-    float highCutOff;
-    float Gravity;
-    float Depth;
-    vector<Layer> layers;
+    float time;
+    double gpuMs;               // average GPU time of evolve + FFT + assemble, per variant
+    oceanReference::StageError initialSpectrum;
+    oceanReference::StageError evolvedSpectrum;   // not written by the fused variant, left at 0
+    oceanReference::StageError displacement;      // xyz, FFT + assemble from the GPU initial spectrum
+    oceanReference::StageError slope;
+    oceanReference::StageError foam;
 };
+
 class OceanFFTGenerator
 {
 public:
@@ -75,49 +138,224 @@ public:
 
     int const TextureCount();
  void spectrumBindBuffer(int location);
- void CalculateSpectrum(ComputeShader Spectrum, ComputeShader conjugate);
- void EvolveSpectrum(ComputeShader shader);
- void IFFT(ComputeShader horizontal, ComputeShader vertical);
- void AssembleTextures(ComputeShader shader);
+ void CalculateSpectrum();
+ // the three passes below run every cascade at time, Update runs the cascades frame.updateInterval schedules
+ void EvolveSpectrum(float time);
+ void IFFT();
+ void AssembleTextures();
+ void Update(float time);
+ // GPU time of Update with the current schedule against every cascade at full rate; the
+ // scheduler's state is put back afterwards, the keys are evaluated again on the next Update
+ ScheduleBenchmark BenchmarkSchedule(float time, int frames = 240);
  void bindTextures();
+ // single dispatch shared memory FFT per direction (stockhamFFT.cps), falls back to the ping-pong loop when unsupported
+ bool useStockhamFFT = true;
+ // with the shared memory FFT: evolve in the row pass and assemble in the column pass, see stockhamFFT.cps
+ bool useFusedFFT = true;
+ // mip levels of displacement/slope built after every update (outputMips.cps), the rest are never sampled
+ int mipLevels = 6;
+ // GPU time of evolve + FFT + assemble for every cascade, separate passes against the fused ones
+ FusionBenchmark BenchmarkFusion(float time, int frames = 240);
+ // Update writes a second output set while bindTextures shows the one finished last frame,
+ // so the render pass doesn't wait on this frame's compute (one frame of latency)
+ bool doubleBuffer = false;
+ // CalculateSpectrum loads cascades baked before from cache/ and saves the ones it bakes (spectrumCache.h)
+ bool useSpectrumCache = true;
+ // GPU time of every pass goes here when set, as "ocean <pass>" scopes (gpuProfiler.h)
+ GpuProfiler* profiler = nullptr;
+ // Offline bake of one RepeatTime period of the current outputs (oceanSequence.h) and its playback:
+ // with playSequence Update uploads and blends the two frames around time instead of running the FFT
+ bool BakeSequence(const std::string& path, float frameRate);
+ bool LoadSequence(const std::string& path);
+ bool HasSequence() const { return sequence != nullptr; }
+ bool playSequence = false;
+ // CPU height queries: Update box filters every cascade to resolution^2 and copies it into a ring of
+ // pixel pack buffers, the newest copy whose fence has passed becomes HeightField (2-3 frames old).
+ // Nothing waits on the GPU, a frame whose ring slot is still in flight just skips its copy.
+ void EnableHeightQueries(int resolution = 128);
+ void DisableHeightQueries();
+ const OceanHeightField& HeightField() const { return heightField; }
+ void SampleHeight(const glm::vec2* positions, float* heights, int count) const { heightField.SampleHeight(positions, heights, count); }
+ void SampleDisplacement(const glm::vec2* positions, glm::vec3* displacements, int count) const { heightField.SampleDisplacement(positions, displacements, count); }
+ // world units one repeat of the cascade covers, its DomainSize (the spectrum's length scale)
+ float CascadeTileSize(int cascade) const { return (float)DomainSizes[cascade]; }
+ perFrameParameters frame;
  void InitialBake(perChangeParameters parameters);
- int const DisplacementTexture();
- int const SlopeTexture();
+ // Bakes parameters under every storage precision policy, runs one frame at time and compares
+ // the outputs with an all-FP32 run. parameters (with its own policy) is baked again afterwards.
+ std::vector<PrecisionMeasurement> MeasurePrecision(perChangeParameters parameters, float time);
+ // Numerical regression check: bakes every seed under the default and the all-FP32 precision policy,
+ // runs every FFT path at every time and reads back the initial spectrum, the evolved spectrum and
+ // the outputs for comparison with oceanReference.h. parameters is baked again afterwards.
+ std::vector<AccuracyMeasurement> MeasureAccuracy(perChangeParameters parameters, const std::vector<int>& seeds,
+     const std::vector<float>& times, int timingFrames = 60);
+ double FrameBandwidth(const OceanPrecision& policy);
+ const OceanPrecision& Precision() const;
+ int DisplacementTexture(int cascade);
+ int SlopeTexture(int cascade);
+ int CascadeSize(int cascade);
  void setDomain(ShaderBase shader);
-void createFFTWaterPlane(const int SIZE);
-void RenderOcean();
+ // points the sampler2DArray[MAX_CASCADES] uniforms at the units bindTextures uses
+ void setSamplers(ShaderBase shader, const char* displacementName, const char* slopeName = nullptr);
+ // float[MAX_CASCADES] uniform of CascadeTileSize, the render shaders sample cascade i at worldPos.xz / size i
+ void setTileSizes(ShaderBase shader, const char* name = "_TileSizes");
+// Camera-following geometry: levels nested square rings of quad patches, patchesPerSide (a multiple
+// of 4) on a side, the patches of level L patchSize * 2^L wide. Every level sits at its own origin,
+// snapped to two of its patches so vertices stay put on the water while the camera moves;
+// oceanPatchCull.cps drops the parts of the next finer level's area and oceanFFT.tcs stitches the
+// seams between levels. The triangle count doesn't depend on how far the water reaches. All levels
+// draw one tile of CLIPMAP_TILE_PATCHES x CLIPMAP_TILE_PATCHES patches, instanced: 64 16-bit indices
+// and no vertex buffer, oceanFFT.vert places the corners from gl_VertexID, so nothing is built on
+// the CPU and the geometry is a few hundred bytes whatever the levels.
+void createClipmap(int levels = 10, int patchesPerSide = 32, float patchSize = 5.0f);
+// about how far the water reaches from the camera, half the width of the outermost level
+float ClipmapRadius() const;
+// oceanPatchCull.cps grows each tile's bounds by a conservative bound of the displacement the
+// cascades add to a point: this many standard deviations of the summed height, the horizontal
+// one scaled by frame.lambda. The variances stay on the GPU, see CalculateSpectrum.
+static constexpr float DISPLACEMENT_SIGMAS = 5.0f;
+// Culls the clipmap's tiles on the GPU (oceanPatchCull.cps) and draws the ones left with a single
+// glDrawElementsIndirect, nothing per patch runs on the CPU. viewProjection is the surface shader's
+// projection * view * model; shader is left in use.
+void RenderOcean(ShaderBase& shader, const glm::vec3& cameraPos, const glm::mat4& viewProjection);
+// RenderOcean's culling: off draws every tile outside the finer levels
+bool cullPatches = true;
+// metres, > 0 bends the surface down with the distance from the camera (oceanFFT.tes) and culls
+// the tiles past the horizon
+float earthRadius = 0.0f;
+// the surface shader's _DisplacementDepthAttenuation, the culling bounds grow with it
+float displacementScale = 1.0f;
 private:
    
     float RandomFloat(float min, float max);
-    struct SpectrumSettings {  
-        float scale;
-        float angle;
-        float spreadBlend;
-        float swell;
-        float alpha;
-        float peakOmega;
-        float gamma;
-        float shortWavesFade;
-    };
    float JonswapAlpha(float fetch, float windSpeed);
    float JonswapPeakFrequency(float fetch, float windSpeed);
    void FillSpectrumStruct(DisplaySpectrumSettings displaySettings, SpectrumSettings& computeSettings);
    void FreeTextures();
-   GLuint N;
    GLuint spectrumBuffer;
-   GLuint initial_spectrumTextures;
-   GLuint spectrumTextures;
-   GLuint pingPongTextures;
-   GLuint displacementTextures;
-   GLuint slopeTextures;
-   GLuint twiddleTexture;
+
+   // storage of one cascade, every array sized to that cascade's own FFT
+   struct Cascade {
+       int size = 0;
+       GLuint initialSpectrum = 0;   // 1 layer
+       GLuint spectrum = 0;          // 2 layers, see time_evolution.cps
+       GLuint pingPong = 0;          // only allocated when the ping-pong FFT fallback runs
+       GLuint displacement = 0;      // 1 layer, foam in alpha
+       GLuint slope = 0;             // 1 layer
+       // with doubleBuffer: the set bindTextures shows, displacement/slope above are being written
+       GLuint frontDisplacement = 0;
+       GLuint frontSlope = 0;
+
+       // scheduled cascades (interval > 1) assemble into two keys evaluated ahead of time,
+       // displacement/slope then hold a blend of the two (cascadeBlend.cps)
+       int interval = 1;
+       GLuint keyDisplacement[2] = { 0, 0 };
+       GLuint keySlope[2] = { 0, 0 };
+       float keyTime[2] = { 0, 0 };
+       int keys = 0;                 // valid keys
+       int newest = 0;               // slot of the latest key
+       int writeSlot = 0;            // slot the next AssembleCascades writes
+   };
+   std::vector<Cascade> cascades;
+   void AllocateCascade(Cascade& cascade, int size);
+   void FreeCascade(Cascade& cascade);
+   void PingPongFFT(Cascade& cascade);
+   void AllocateKeys(Cascade& cascade);
+   std::vector<int> AllCascades() const;
+   static float SpectrumVariance(const std::vector<unsigned char>& texels, bool fp32);
+   void EvolveCascades(const std::vector<int>& which, const std::vector<float>& times);
+   void FFTCascades(const std::vector<int>& which);
+   void AssembleCascades(const std::vector<int>& which, bool toKeys);
+   void BindAssembleTargets(ShaderBase& shader, Cascade& cascade, bool toKeys);
+   void FusedCascades(const std::vector<int>& which, const std::vector<float>& times, bool toKeys);
+   void SimulateCascades(const std::vector<int>& which, const std::vector<float>& times, bool toKeys);
+   void BlendCascades(float time);
+   void SwapOutputs();
+   void FreeFrontOutputs();
+   bool outputsPending = false;   // the last double buffered Update's outputs aren't shown yet
+   void BlendKeys(Cascade& cascade, int previous, int next, float blend);
+
+   std::unique_ptr<OceanSequence::Reader> sequence;
+   int sequenceSlots[2] = { -1, -1 };    // sequence frame held by each cascade key slot
+   bool SequenceMatches() const;
+   void PlaySequence(float time);
+
+   static const int HEIGHT_READBACK_SLOTS = 3;
+   struct HeightReadback {
+       GLuint buffer = 0;
+       GLsync fence = 0;
+       float time = 0;
+   };
+   HeightReadback heightReadbacks[HEIGHT_READBACK_SLOTS];
+   int heightReadbackNext = 0;
+   int heightResolution = 0;          // 0 while the queries are off
+   GLuint heightReadbackTexture = 0;  // resolution^2, one layer per cascade
+   int heightReadbackLayers = 0;
+   std::unique_ptr<ComputeShader> heightReadbackShader;
+   OceanHeightField heightField;
+   void QueueHeightReadback(float time);
+   // Update's clock: frame counter for the round robin, smoothed frame time for the key look-ahead
+   unsigned updateFrame = 0;
+   float lastUpdateTime = -1.0f;
+   float averageFrameTime = 1.0f / 60.0f;
+
+   // shared memory FFT per size, both null when the size doesn't fit the workgroup limits
+   struct StockhamFFT {
+       std::unique_ptr<ComputeShader> horizontal;
+       std::unique_ptr<ComputeShader> vertical;
+       // FUSE_EVOLUTION / FUSE_ASSEMBLE, both null when two lines don't fit in shared memory
+       std::unique_ptr<ComputeShader> fusedHorizontal;
+       std::unique_ptr<ComputeShader> fusedVertical;
+   };
+   std::map<int, StockhamFFT> stockhamPrograms;
+   const StockhamFFT* StockhamFor(int size);
+   void FreeStockhamFFT();
+
+   // storage formats, see OceanPrecision
+   OceanPrecision precision;
+   GLenum InitialSpectrumFormat() const { return precision.initialSpectrum ? GL_RGBA32F : GL_RGBA16F; }
+   GLenum SpectrumFormat() const { return precision.evolvedSpectrum ? GL_RGBA32F : GL_RGBA16F; }
+   GLenum ScratchFormat() const { return precision.fftScratch ? GL_RGBA32F : GL_RGBA16F; }
+   GLenum DisplacementFormat() const { return precision.outputs ? GL_RGBA32F : GL_RGBA16F; }
+   GLenum SlopeFormat() const { return precision.outputs ? GL_RG32F : GL_RG16F; }
+   std::string FormatDefines() const;
+   size_t InitialSpectrumBytes(int size) const { return (size_t)size * size * (precision.initialSpectrum ? 16 : 8); }
+
+   // per frame pipeline, compiled for the current precision by BuildShaders
+   std::unique_ptr<ComputeShader> spectrumShader;
+   std::unique_ptr<ComputeShader> conjugateShader;
+   std::unique_ptr<ComputeShader> evolveShader;
+   std::unique_ptr<ComputeShader> horizontalShader;
+   std::unique_ptr<ComputeShader> verticalShader;
+   std::unique_ptr<ComputeShader> assembleShader;
+   std::unique_ptr<ComputeShader> blendShader;
+   std::unique_ptr<ComputeShader> mipShader;
+   std::unique_ptr<ComputeShader> varianceShader;
+   // float per cascade (MAX_CASCADES): time average of the height's spatial variance, written by
+   // CalculateSpectrum (spectrumVariance.cps, or from the texels of a cache hit)
+   GLuint heightVarianceBuffer = 0;
+   void BuildMips();
+   void BuildShaders();
+   void ReadOutputs(std::vector<float>& displacement, std::vector<float>& slope);
+
+   // last InitialBake, diffed against the next one
+   perChangeParameters baked;
+   bool hasBaked = false;
+   std::vector<bool> dirtyLayers;
 
    vector<int>DomainSizes;  
    std::vector<SpectrumSettings> spectrums;
-   void defaultSpectrum(vector<Layer>& layers);
 
-   GLuint planeModel;
-   GLuint indices;
+   // createClipmap: one tile, instanced once per tile oceanPatchCull.cps keeps
+   static const int MAX_CLIPMAP_LEVELS = 24;   // _RingOrigins[] of the clipmap shaders
+   static const int CLIPMAP_TILE_PATCHES = 4;  // on a side, patchesPerSide is a multiple of it
+   GLuint planeModel = 0;     // the tile's index buffer and the per-instance attribute, no vertices
+   GLuint patchBuffer = 0;    // vec4 per instance: xz origin, patch width, level
+   GLuint drawCommand = 0;    // DrawElementsIndirectCommand, instanceCount written by the cull pass
+   std::unique_ptr<ComputeShader> cullShader;
+   int clipmapLevels = 0;
+   int clipmapPatches = 0;
+   float clipmapPatchSize = 0;
   
    //parameters
    float gravity = 9.81;  // Gravity constant
@@ -131,84 +369,59 @@ OceanFFTGenerator::OceanFFTGenerator(vector<Layer>& layers) {
     //          Spectrum Buffer
     ///////////////////////////////////
     glGenBuffers(1, &spectrumBuffer);
+    glCreateBuffers(1, &heightVarianceBuffer);
+    glNamedBufferData(heightVarianceBuffer, MAX_CASCADES * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+    glClearNamedBufferData(heightVarianceBuffer, GL_R32F, GL_RED, GL_FLOAT, nullptr);
 
-    int textureSize = 512;
-    
-    //Textures 
- ///////////////////////////////////////
-   
-    initial_spectrumTextures = CreateTextureArray(textureSize, textureSize, 4, GL_RGBA16F, true);  // ARGBHalf in Unity
-    spectrumTextures = CreateTextureArray(textureSize, textureSize, 8, GL_RGBA16F, true);     
-     pingPongTextures   = CreateTextureArray(textureSize, textureSize, 8, GL_RGBA16F, true);            
-    displacementTextures = CreateTextureArray(textureSize, textureSize, 4, GL_RGBA16F, true);     // ARGBHalf
-    slopeTextures = CreateTextureArray(textureSize, textureSize, 4, GL_RG16F, true);              // RGHalf
-   
-
-
-    glGenTextures(1, &twiddleTexture);
-    glBindTexture(GL_TEXTURE_2D, twiddleTexture);
-    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, log2(textureSize), textureSize); // log2(FFTSize) FFT stages, FFTSize entries
-
-    // Set texture parameters (use NEAREST filtering to avoid interpolation)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-    // Bind it to the compute shader
-    glBindImageTexture(0, twiddleTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
-
-    ComputeShader precomputeDiddy("precomputeDiddyFactor.cps");
-    precomputeDiddy.use();
-    precomputeDiddy.setInt("Size",textureSize);
-    glDispatchCompute(log2(textureSize) , textureSize/2 / 8, 1);
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-
-    N = textureSize;
-    defaultSpectrum(layers);
-    glDeleteProgram(precomputeDiddy.ID);
-    return;
-
- 
-   
+    perChangeParameters parameters = DefaultParameters();
+    layers = parameters.layers;
+    InitialBake(parameters);
 }
+// Diffs parameters against the last bake: a cascade's storage is only reallocated when its size or the
+// precision changed, and CalculateSpectrum only redoes the cascades marked dirty here.
 void OceanFFTGenerator::InitialBake(perChangeParameters parameters) {
 
-    FreeTextures();  // 🔥 Prevent memory leaks
+    bool formatsChanged = !evolveShader || parameters.precision != precision;
+    // these feed every cascade's spectrum
+    bool globalsChanged = !hasBaked || parameters.seed != baked.seed || parameters.lowCutOff != baked.lowCutOff
+        || parameters.highCutOff != baked.highCutOff || parameters.Gravity != baked.Gravity || parameters.Depth != baked.Depth;
+    precision = parameters.precision;
+    if (formatsChanged) {
+        FreeTextures();
+        FreeStockhamFFT();
+        BuildShaders();
+    }
     //Textures 
 ///////////////////////////////////////
-    int textureSize = parameters.TextureSize;
     int amount = parameters.TextureCount;
-    initial_spectrumTextures = CreateTextureArray(textureSize, textureSize, amount, GL_RGBA16F, true);  // ARGBHalf in Unity
-    spectrumTextures = CreateTextureArray(textureSize, textureSize, amount*2, GL_RGBA16F, true);
-    pingPongTextures = CreateTextureArray(textureSize, textureSize, amount*2, GL_RGBA16F, true);
-    displacementTextures = CreateTextureArray(textureSize, textureSize, amount, GL_RGBA16F, true);     // ARGBHalf
-    slopeTextures = CreateTextureArray(textureSize, textureSize, amount, GL_RG16F, true);              // RGHalf
-
-    cout << textureSize<<endl;
-
-    int logSize = static_cast<int>(log2(textureSize));  
-
-    glGenTextures(1, &twiddleTexture);
-    glBindTexture(GL_TEXTURE_2D, twiddleTexture);
-    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, logSize, textureSize); // log2(FFTSize) FFT stages, FFTSize entries
-
-    // Set texture parameters (use NEAREST filtering to avoid interpolation)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-    // Bind it to the compute shader
-    glBindImageTexture(0, twiddleTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    for (int i = amount; i < (int)cascades.size(); ++i)
+        FreeCascade(cascades[i]);
+    cascades.resize(amount);
+    // a layer stays dirty until CalculateSpectrum has run for it
+    dirtyLayers.resize(amount, true);
+
+    for (int i = 0; i < amount; ++i) {
+        int textureSize = LayerTextureSize(parameters, i);
+        bool reallocate = cascades[i].size != textureSize;
+        if (reallocate) {
+            FreeCascade(cascades[i]);
+            AllocateCascade(cascades[i], textureSize);
+        }
+        if (useStockhamFFT)
+            StockhamFor(textureSize);  // compile now rather than on the first frame
+        dirtyLayers[i] = dirtyLayers[i] || reallocate || globalsChanged
+            || i >= (int)baked.layers.size() || parameters.layers[i] != baked.layers[i];
+    }
+    baked = parameters;
+    hasBaked = true;
 
-    ComputeShader precomputeDiddy("precomputeDiddyFactor.cps");
-    precomputeDiddy.use();
-    precomputeDiddy.setInt("Size", textureSize);
-    glDispatchCompute(logSize, textureSize / 2 / 8, 1);
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    Depth = parameters.Depth;
+    gravity = parameters.Gravity;
+    highCutOff = parameters.highCutOff;
+    lowCutOff = parameters.lowCutOff;
+    seed = parameters.seed;
 
-    N = textureSize;
+    // gravity has to be set first, the JONSWAP terms depend on it
     DomainSizes.clear();
     spectrums.resize(amount*2);
     
@@ -217,33 +430,82 @@ void OceanFFTGenerator::InitialBake(perChangeParameters parameters) {
        FillSpectrumStruct(parameters.layers[i].spec1, spectrums[i * 2]);
         FillSpectrumStruct(parameters.layers[i].spec2, spectrums[i * 2 + 1]);
     }
+}
+OceanFFTGenerator::~OceanFFTGenerator() {
+    DisableHeightQueries();
+}
 
-    Depth = parameters.Depth;
-    gravity = parameters.Gravity;
-    highCutOff = parameters.highCutOff;
-    lowCutOff = parameters.lowCutOff;
-    seed = parameters.seed;
-    glDeleteProgram(precomputeDiddy.ID);
+// "#define X_FORMAT ..." for every image the compute shaders declare
+std::string OceanFFTGenerator::FormatDefines() const {
+    auto rgba = [](bool fp32) { return fp32 ? " rgba32f\n" : " rgba16f\n"; };
+    std::string defines;
+    defines += std::string("#define INITIAL_SPECTRUM_FORMAT") + rgba(precision.initialSpectrum);
+    defines += std::string("#define SPECTRUM_FORMAT") + rgba(precision.evolvedSpectrum);
+    defines += std::string("#define SCRATCH_FORMAT") + rgba(precision.fftScratch);
+    defines += std::string("#define DISPLACEMENT_FORMAT") + rgba(precision.outputs);
+    defines += std::string("#define SLOPE_FORMAT") + (precision.outputs ? " rg32f\n" : " rg16f\n");
+    return defines;
+}
+void OceanFFTGenerator::BuildShaders() {
+    for (std::unique_ptr<ComputeShader>* shader : { &spectrumShader, &conjugateShader, &evolveShader,
+                                                    &horizontalShader, &verticalShader, &assembleShader, &blendShader, &mipShader, &heightReadbackShader, &varianceShader }) {
+        if (*shader) glDeleteProgram((*shader)->ID);
+    }
+    std::string defines = FormatDefines();
+    spectrumShader = std::make_unique<ComputeShader>("Spectrum_INIT.cps", defines);
+    conjugateShader = std::make_unique<ComputeShader>("SpectrumConjugate.cps", defines);
+    evolveShader = std::make_unique<ComputeShader>("time_evolution.cps", defines);
+    horizontalShader = std::make_unique<ComputeShader>("horizontalFFT.cps", defines);
+    verticalShader = std::make_unique<ComputeShader>("verticalFFT.cps", defines);
+    assembleShader = std::make_unique<ComputeShader>("fftNormalize.cps", defines);
+    blendShader = std::make_unique<ComputeShader>("cascadeBlend.cps", defines);
+    mipShader = std::make_unique<ComputeShader>("outputMips.cps", defines);
+    heightReadbackShader = std::make_unique<ComputeShader>("heightReadback.cps", defines);
+    varianceShader = std::make_unique<ComputeShader>("spectrumVariance.cps", defines);
+}
+const OceanPrecision& OceanFFTGenerator::Precision() const {
+    return precision;
 }
-OceanFFTGenerator::~OceanFFTGenerator() {}
 
+void OceanFFTGenerator::AllocateCascade(Cascade& cascade, int size) {
+    cascade.size = size;
+    // spectra are only touched through image load/store, so no mip chain; this only saves memory,
+    // the benchmark sweep times the same with or without the unused levels
+    cascade.initialSpectrum = CreateTextureArray(size, size, 1, InitialSpectrumFormat(), false);  // ARGBHalf in Unity
+    cascade.spectrum = CreateTextureArray(size, size, 2, SpectrumFormat(), false);
+    cascade.displacement = CreateTextureArray(size, size, 1, DisplacementFormat(), true);     // ARGBHalf
+    cascade.slope = CreateTextureArray(size, size, 1, SlopeFormat(), true);              // RGHalf
+    // foam accumulates in displacement.a, start without any
+    glClearTexImage(cascade.displacement, 0, GL_RGBA, GL_FLOAT, nullptr);
+    // no mip is valid until BuildMips ran
+    glTextureParameteri(cascade.displacement, GL_TEXTURE_MAX_LEVEL, 0);
+    glTextureParameteri(cascade.slope, GL_TEXTURE_MAX_LEVEL, 0);
+}
+void OceanFFTGenerator::FreeCascade(Cascade& cascade) {
+    if (cascade.initialSpectrum != 0) glDeleteTextures(1, &cascade.initialSpectrum);
+    if (cascade.spectrum != 0) glDeleteTextures(1, &cascade.spectrum);
+    if (cascade.pingPong != 0) glDeleteTextures(1, &cascade.pingPong);
+    if (cascade.displacement != 0) glDeleteTextures(1, &cascade.displacement);
+    if (cascade.slope != 0) glDeleteTextures(1, &cascade.slope);
+    if (cascade.frontDisplacement != 0) glDeleteTextures(1, &cascade.frontDisplacement);
+    if (cascade.frontSlope != 0) glDeleteTextures(1, &cascade.frontSlope);
+    for (int k = 0; k < 2; ++k) {
+        if (cascade.keyDisplacement[k] != 0) glDeleteTextures(1, &cascade.keyDisplacement[k]);
+        if (cascade.keySlope[k] != 0) glDeleteTextures(1, &cascade.keySlope[k]);
+    }
+    cascade = Cascade();
+    sequenceSlots[0] = sequenceSlots[1] = -1;
+}
+void OceanFFTGenerator::AllocateKeys(Cascade& cascade) {
+    for (int k = 0; k < 2; ++k) {
+        cascade.keyDisplacement[k] = CreateTextureArray(cascade.size, cascade.size, 1, DisplacementFormat(), false);
+        cascade.keySlope[k] = CreateTextureArray(cascade.size, cascade.size, 1, SlopeFormat(), false);
+    }
+    cascade.keys = 0;
+}
 void OceanFFTGenerator::FreeTextures() {
-
-    
-
-   if (initial_spectrumTextures!=0) glDeleteTextures(1, &initial_spectrumTextures);
-    if (spectrumTextures!=0) glDeleteTextures(1, &spectrumTextures);
-    if (pingPongTextures!=0) glDeleteTextures(1, &pingPongTextures);
-  if (displacementTextures!=0) glDeleteTextures(1, &displacementTextures);
-    if (slopeTextures!=0) glDeleteTextures(1, &slopeTextures);
-    if (twiddleTexture!=0) glDeleteTextures(1, &twiddleTexture);
-
-    initial_spectrumTextures = 0;
-    spectrumTextures = 0;
-    pingPongTextures = 0;
-    displacementTextures = 0;
-    slopeTextures = 0;
-    twiddleTexture = 0;
+    for (Cascade& cascade : cascades)
+        FreeCascade(cascade);
 }
 
 void OceanFFTGenerator::GenerateSpectrums(int count)
@@ -280,23 +542,15 @@ float OceanFFTGenerator::RandomFloat(float min, float max)
     return dis(gen);
 }
 float  OceanFFTGenerator::JonswapAlpha(float fetch, float windSpeed) {
-    return 0.076f * glm::pow(gravity * fetch / windSpeed / windSpeed, -0.22f);
+    return ::JonswapAlpha(fetch, windSpeed, gravity);
 }
 
 float  OceanFFTGenerator::JonswapPeakFrequency(float fetch, float windSpeed) {
-    return 22 * glm::pow(windSpeed * fetch / gravity / gravity, -0.33f);
+    return ::JonswapPeakFrequency(fetch, windSpeed, gravity);
 }
 
 void OceanFFTGenerator::FillSpectrumStruct(DisplaySpectrumSettings displaySettings,  SpectrumSettings& computeSettings) {
-    computeSettings.scale = displaySettings.scale;
-    computeSettings.angle = displaySettings.windDirection / 180 * glm::pi<float>();
-    computeSettings.spreadBlend = displaySettings.spreadBlend;
-    computeSettings.swell = glm::clamp<float>(displaySettings.swell, 0.01f, 1);
-    computeSettings.alpha = JonswapAlpha(displaySettings.fetch, displaySettings.windSpeed);
-    computeSettings.peakOmega = JonswapPeakFrequency(displaySettings.fetch, displaySettings.windSpeed);
-    computeSettings.gamma = displaySettings.peakEnhancement;
-    computeSettings.shortWavesFade = displaySettings.shortWavesFade;
-   
+    ::FillSpectrumStruct(displaySettings, computeSettings, gravity);
 }
 void OceanFFTGenerator::spectrumBindBuffer(int location) {
 
@@ -309,308 +563,1245 @@ void OceanFFTGenerator::spectrumBindBuffer(int location) {
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, location, spectrumBuffer);
 }
 
-void OceanFFTGenerator::CalculateSpectrum(ComputeShader Spectrum, ComputeShader conjugate ) {
+void OceanFFTGenerator::CalculateSpectrum() {
  
-    Spectrum.use();  
+    spectrumShader->use();  
  spectrumBindBuffer(1);
- Spectrum.setFloat("_Gravity", gravity);
- Spectrum.setInt("_Seed", seed);
- Spectrum.setFloat("_Depth", Depth);
- Spectrum.setFloat("_LowCutoff", lowCutOff);
- Spectrum.setFloat("_HighCutoff", highCutOff);
- Spectrum.setInt("n", N);
-    setDomain(Spectrum);
-    glBindImageTexture(0, initial_spectrumTextures, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA16F);
-    glDispatchCompute(N / 16,  N/ 16, DomainSizes.size());
+ int dirtyCount = (int)std::count(dirtyLayers.begin(), dirtyLayers.end(), true);
+ if (dirtyCount == 0)
+     return;
+    GpuProfiler::Scope scope(profiler, "ocean spectrum");
+
+    // cache hits are uploaded as they are and drop out of the dispatches below
+    GLenum texelType = precision.initialSpectrum ? GL_FLOAT : GL_HALF_FLOAT;
+    std::vector<bool> bake = dirtyLayers;
+    if (useSpectrumCache) {
+        std::vector<unsigned char> texels;
+        for (int i = 0; i < (int)bake.size(); ++i) {
+            if (!bake[i]) continue;
+            Cascade& cascade = cascades[i];
+            size_t bytes = InitialSpectrumBytes(cascade.size);
+            if (!SpectrumCache::Load(SpectrumCache::Key(baked, i, cascade.size, precision.initialSpectrum), bytes, texels))
+                continue;
+            glTextureSubImage3D(cascade.initialSpectrum, 0, 0, 0, 0, cascade.size, cascade.size, 1, GL_RGBA, texelType, texels.data());
+            bake[i] = false;
+            // the texels are at hand, what spectrumVariance.cps would sum on the GPU
+            if (i < MAX_CASCADES) {
+                float variance = SpectrumVariance(texels, precision.initialSpectrum);
+                glNamedBufferSubData(heightVarianceBuffer, i * sizeof(float), sizeof(float), &variance);
+            }
+        }
+    }
+ spectrumShader->setFloat("_Gravity", gravity);
+ spectrumShader->setInt("_Seed", seed);
+ spectrumShader->setFloat("_Depth", Depth);
+ spectrumShader->setFloat("_LowCutoff", lowCutOff);
+ spectrumShader->setFloat("_HighCutoff", highCutOff);
+ setDomain(*spectrumShader);
+    // one dispatch per dirty cascade, the others keep their spectrum
+    for (int i = 0; i < (int)bake.size(); ++i) {
+        if (!bake[i]) continue;
+        Cascade& cascade = cascades[i];
+        spectrumShader->setInt("n", cascade.size);
+        spectrumShader->setInt("_Cascade", i);
+        glBindImageTexture(0, cascade.initialSpectrum, 0, GL_TRUE, 0, GL_READ_WRITE, InitialSpectrumFormat());
+        glDispatchCompute(cascade.size / 16, cascade.size / 16, 1);
+    }
     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-    conjugate.use();
-    conjugate.setInt("n", N);
+    conjugateShader->use();
    
-  
-    glDispatchCompute(N / 16, N / 16, DomainSizes.size());
+    for (int i = 0; i < (int)bake.size(); ++i) {
+        if (!bake[i]) continue;
+        Cascade& cascade = cascades[i];
+        conjugateShader->setInt("n", cascade.size);
+        glBindImageTexture(0, cascade.initialSpectrum, 0, GL_TRUE, 0, GL_READ_WRITE, InitialSpectrumFormat());
+        glDispatchCompute(cascade.size / 16, cascade.size / 16, 1);
+    }
     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-   
+
+    if (useSpectrumCache) {
+        glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+        std::vector<unsigned char> texels;
+        for (int i = 0; i < (int)bake.size(); ++i) {
+            if (!bake[i]) continue;
+            Cascade& cascade = cascades[i];
+            texels.resize(InitialSpectrumBytes(cascade.size));
+            glGetTextureImage(cascade.initialSpectrum, 0, GL_RGBA, texelType, (GLsizei)texels.size(), texels.data());
+            SpectrumCache::Save(SpectrumCache::Key(baked, i, cascade.size, precision.initialSpectrum), texels);
+        }
+    }
+
+    // keys of a rebaked cascade belong to the old spectrum
+    for (int i = 0; i < (int)dirtyLayers.size(); ++i)
+        if (dirtyLayers[i]) cascades[i].keys = 0;
+
+    // the height variances of the baked cascades, reduced on the GPU and never read back
+    varianceShader->use();
+    for (int i = 0; i < (int)bake.size() && i < MAX_CASCADES; ++i) {
+        if (!bake[i]) continue;
+        varianceShader->setInt("_Cascade", i);
+        glBindImageTexture(0, cascades[i].initialSpectrum, 0, GL_TRUE, 0, GL_READ_ONLY, InitialSpectrumFormat());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, heightVarianceBuffer);
+        glDispatchCompute(1, 1, 1);
+    }
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    std::fill(dirtyLayers.begin(), dirtyLayers.end(), false);
+}
+// spectrumVariance.cps over texels of InitialSpectrumBytes: sum of |h0(k)|^2 + |h0(-k)|^2
+float OceanFFTGenerator::SpectrumVariance(const std::vector<unsigned char>& texels, bool fp32) {
+    double variance = 0;
+    if (fp32) {
+        const float* values = reinterpret_cast<const float*>(texels.data());
+        for (size_t v = 0; v < texels.size() / sizeof(float); ++v)
+            variance += double(values[v]) * values[v];
+    }
+    else {
+        const glm::uint16* values = reinterpret_cast<const glm::uint16*>(texels.data());
+        for (size_t v = 0; v < texels.size() / sizeof(glm::uint16); ++v) {
+            double value = glm::unpackHalf1x16(values[v]);
+            variance += value * value;
+        }
+    }
+    return (float)variance;
+}
+std::vector<int> OceanFFTGenerator::AllCascades() const {
+    std::vector<int> all(cascades.size());
+    for (int i = 0; i < (int)all.size(); ++i)
+        all[i] = i;
+    return all;
+}
+void OceanFFTGenerator::EvolveSpectrum(float time) {
+    EvolveCascades(AllCascades(), std::vector<float>(cascades.size(), time));
+}
+void OceanFFTGenerator::IFFT() {
+    FFTCascades(AllCascades());
 }
-void OceanFFTGenerator::EvolveSpectrum(ComputeShader shader) {
-    shader.setInt("n",N);
-    shader.setFloat("G", gravity);
-    setDomain(shader);
-    glBindImageTexture(0, initial_spectrumTextures, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA16F);
-    glBindImageTexture(1, spectrumTextures, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA16F);
-    glDispatchCompute(N / 16, N / 16, DomainSizes.size());
+void OceanFFTGenerator::AssembleTextures() {
+    AssembleCascades(AllCascades(), false);
+    BuildMips();
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+// outputMips.cps writes three levels per dispatch from the level above, so mipLevels <= 3 is one
+// pass and <= 6 two. Levels past mipLevels are cut off with GL_TEXTURE_MAX_LEVEL instead of built.
+void OceanFFTGenerator::BuildMips() {
+    int passes = 0;
+    for (const Cascade& cascade : cascades) {
+        int levels = glm::clamp(mipLevels, 0, (int)log2(cascade.size));
+        glTextureParameteri(cascade.displacement, GL_TEXTURE_MAX_LEVEL, levels);
+        glTextureParameteri(cascade.slope, GL_TEXTURE_MAX_LEVEL, levels);
+        passes = glm::max(passes, (levels + 2) / 3);
+    }
+    if (passes == 0) return;
+    GpuProfiler::Scope scope(profiler, "ocean mips");
+    mipShader->use();
+    for (int pass = 0; pass < passes; ++pass) {
+        // level 0 comes from the passes before, later sources from the previous mip pass
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        int source = pass * 3;
+        for (const Cascade& cascade : cascades) {
+            int levels = glm::clamp(mipLevels, 0, (int)log2(cascade.size));
+            int count = glm::min(3, levels - source);
+            if (count <= 0) continue;
+            mipShader->setInt("_Levels", count);
+            glBindImageTexture(0, cascade.displacement, source, GL_TRUE, 0, GL_READ_ONLY, DisplacementFormat());
+            glBindImageTexture(1, cascade.slope, source, GL_TRUE, 0, GL_READ_ONLY, SlopeFormat());
+            for (int k = 0; k < 3; ++k) {
+                // units past count are never written, point them at a level that exists
+                int level = source + 1 + glm::min(k, count - 1);
+                glBindImageTexture(2 + k, cascade.displacement, level, GL_TRUE, 0, GL_WRITE_ONLY, DisplacementFormat());
+                glBindImageTexture(5 + k, cascade.slope, level, GL_TRUE, 0, GL_WRITE_ONLY, SlopeFormat());
+            }
+            int groups = glm::max(1, (cascade.size >> (source + 1)) / 8);
+            glDispatchCompute(groups, groups, 1);
+        }
+    }
+}
+// Cascade i runs every frame.updateInterval[i] frames. Cascades sharing an interval are spread over
+// its frames round robin, so with e.g. three cascades at 1/4 rate at most one of them runs per frame.
+// A scheduled cascade is evaluated interval frames ahead and its output blends from the previous key
+// to that one, landing on it by the time the cascade runs again.
+void OceanFFTGenerator::Update(float time) {
+    if (lastUpdateTime >= 0 && time > lastUpdateTime)
+        averageFrameTime = glm::mix(averageFrameTime, time - lastUpdateTime, 0.1f);
+    lastUpdateTime = time;
+
+    if (playSequence && SequenceMatches()) {
+        PlaySequence(time);
+        BuildMips();
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+        QueueHeightReadback(time);
+        return;
+    }
+    sequenceSlots[0] = sequenceSlots[1] = -1;
+
+    if (doubleBuffer) {
+        SwapOutputs();
+        // this result is shown next frame, evaluate it for then
+        time += averageFrameTime;
+    }
+    else
+        FreeFrontOutputs();
+
+    std::vector<int> due;
+    std::vector<float> times;
+    std::vector<int> phases(MAX_UPDATE_INTERVAL + 1, 0);
+    for (int i = 0; i < (int)cascades.size(); ++i) {
+        Cascade& cascade = cascades[i];
+        int interval = i < MAX_CASCADES ? glm::clamp(frame.updateInterval[i], 1, MAX_UPDATE_INTERVAL) : 1;
+        cascade.interval = interval;
+        if (interval == 1) {
+            due.push_back(i);
+            times.push_back(time);
+            continue;
+        }
+        int phase = phases[interval]++ % interval;
+        if (cascade.keyDisplacement[0] == 0)
+            AllocateKeys(cascade);
+        if (cascade.keys == 0 || (updateFrame + phase) % interval == 0) {
+            float keyTime = cascade.keys == 0 ? time : time + interval * averageFrameTime;
+            cascade.writeSlot = cascade.keys == 0 ? cascade.newest : 1 - cascade.newest;
+            cascade.keyTime[cascade.writeSlot] = keyTime;
+            due.push_back(i);
+            times.push_back(keyTime);
+        }
+    }
+    ++updateFrame;
+
+    SimulateCascades(due, times, true);
+
+    for (int i : due) {
+        Cascade& cascade = cascades[i];
+        if (cascade.interval == 1) continue;
+        cascade.newest = cascade.writeSlot;
+        cascade.keys = glm::min(cascade.keys + 1, 2);
+    }
+    bool blending = false;
+    for (const Cascade& cascade : cascades)
+        blending = blending || (cascade.interval > 1 && cascade.keys > 0);
+    if (blending) {
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        BlendCascades(time);
+    }
+
+    BuildMips();
+
+    // single buffered the render pass samples these outputs right away, double buffered
+    // the barrier moves to the next Update, after this frame's draws were submitted
+    if (doubleBuffer)
+        outputsPending = true;
+    else
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    QueueHeightReadback(time);
+}
+void OceanFFTGenerator::EnableHeightQueries(int resolution) {
+    DisableHeightQueries();
+    heightResolution = resolution;
+}
+void OceanFFTGenerator::DisableHeightQueries() {
+    for (HeightReadback& slot : heightReadbacks) {
+        if (slot.fence) glDeleteSync(slot.fence);
+        if (slot.buffer) glDeleteBuffers(1, &slot.buffer);
+        slot = HeightReadback();
+    }
+    if (heightReadbackTexture) glDeleteTextures(1, &heightReadbackTexture);
+    heightReadbackTexture = 0;
+    heightReadbackLayers = 0;
+    heightResolution = 0;
+    heightField.Resize(0, {});
+}
+// Collects every finished copy without blocking, then queues this frame's: box filter into
+// heightReadbackTexture, glGetTextureImage into the next ring buffer, fence.
+void OceanFFTGenerator::QueueHeightReadback(float time) {
+    if (heightResolution == 0 || cascades.empty())
+        return;
+    int layers = (int)cascades.size();
+    size_t bytes = (size_t)heightResolution * heightResolution * layers * sizeof(glm::vec4);
+    // a rebake can change a cascade's DomainSize and so its period without changing the count;
+    // the copies in flight hold the old periods and are dropped with the rest
+    std::vector<float> tileSizes(layers);
+    for (int i = 0; i < layers; ++i)
+        tileSizes[i] = CascadeTileSize(i);
+    if (heightReadbackLayers != layers || heightField.TileSizes() != tileSizes) {
+        int resolution = heightResolution;
+        DisableHeightQueries();
+        heightResolution = resolution;
+        heightReadbackTexture = CreateTextureArray(resolution, resolution, layers, GL_RGBA32F, false);
+        heightReadbackLayers = layers;
+        for (HeightReadback& slot : heightReadbacks) {
+            glCreateBuffers(1, &slot.buffer);
+            glNamedBufferStorage(slot.buffer, bytes, nullptr, GL_MAP_READ_BIT);
+        }
+        heightField.Resize(resolution, tileSizes);
+    }
+
+    // oldest first, so the newest finished copy ends up in heightField
+    for (int k = 0; k < HEIGHT_READBACK_SLOTS; ++k) {
+        HeightReadback& slot = heightReadbacks[(heightReadbackNext + k) % HEIGHT_READBACK_SLOTS];
+        if (!slot.fence)
+            continue;
+        GLenum status = glClientWaitSync(slot.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            continue;
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+        const void* data = glMapNamedBufferRange(slot.buffer, 0, bytes, GL_MAP_READ_BIT);
+        if (data) {
+            memcpy(heightField.Texels().data(), data, bytes);
+            heightField.time = slot.time;
+        }
+        glUnmapNamedBuffer(slot.buffer);
+    }
+
+    HeightReadback& slot = heightReadbacks[heightReadbackNext];
+    if (slot.fence)
+        return;    // the GPU is more than a ring behind, skip rather than wait
+    heightReadbackShader->use();
+    glBindImageTexture(1, heightReadbackTexture, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    for (int i = 0; i < layers; ++i) {
+        heightReadbackShader->setInt("_Cascade", i);
+        glBindImageTexture(0, DisplacementTexture(i), 0, GL_TRUE, 0, GL_READ_ONLY, DisplacementFormat());
+        glDispatchCompute((heightResolution + 7) / 8, (heightResolution + 7) / 8, 1);
+    }
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glGetTextureImage(heightReadbackTexture, 0, GL_RGBA, GL_FLOAT, (GLsizei)bytes, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.time = time;
+    heightReadbackNext = (heightReadbackNext + 1) % HEIGHT_READBACK_SLOTS;
+}
+// Makes last frame's outputs the displayed set and hands the old displayed set to this frame's
+// passes. Front arrays are created on the first double buffered frame.
+// Commands of one context run in order, so waiting on a fence here would add nothing; the render
+// pass only needs last frame's image stores visible to its samplers. The assembly imageLoads the
+// front set's foam behind the evolve (or fused row pass) barrier, only the height readback may
+// read it before any.
+void OceanFFTGenerator::SwapOutputs() {
+    if (outputsPending) {
+        outputsPending = false;
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | (heightResolution > 0 ? GL_SHADER_IMAGE_ACCESS_BARRIER_BIT : 0));
+    }
+    for (Cascade& cascade : cascades) {
+        if (cascade.frontDisplacement == 0) {
+            cascade.frontDisplacement = CreateTextureArray(cascade.size, cascade.size, 1, DisplacementFormat(), true);
+            cascade.frontSlope = CreateTextureArray(cascade.size, cascade.size, 1, SlopeFormat(), true);
+            // start from the single buffered result so foam carries over
+            glCopyImageSubData(cascade.displacement, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+                cascade.frontDisplacement, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, cascade.size, cascade.size, 1);
+            glCopyImageSubData(cascade.slope, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+                cascade.frontSlope, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, cascade.size, cascade.size, 1);
+            glTextureParameteri(cascade.frontDisplacement, GL_TEXTURE_MAX_LEVEL, 0);
+            glTextureParameteri(cascade.frontSlope, GL_TEXTURE_MAX_LEVEL, 0);
+        }
+        std::swap(cascade.displacement, cascade.frontDisplacement);
+        std::swap(cascade.slope, cascade.frontSlope);
+    }
+}
+void OceanFFTGenerator::FreeFrontOutputs() {
+    if (outputsPending) {
+        outputsPending = false;
+        // the last double buffered frame was never shown, show it now
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+    for (Cascade& cascade : cascades) {
+        if (cascade.frontDisplacement == 0) continue;
+        glDeleteTextures(1, &cascade.frontDisplacement);
+        glDeleteTextures(1, &cascade.frontSlope);
+        cascade.frontDisplacement = cascade.frontSlope = 0;
+    }
+}
+void OceanFFTGenerator::EvolveCascades(const std::vector<int>& which, const std::vector<float>& times) {
+    if (which.empty()) return;
+    GpuProfiler::Scope scope(profiler, "ocean evolve");
+    evolveShader->use();
+    evolveShader->setInt("speed", frame.speed);
+    evolveShader->setFloat("RepeatTime", frame.repeatTime);
+    evolveShader->setFloat("G", gravity);
+    setDomain(*evolveShader);
+    for (size_t k = 0; k < which.size(); ++k) {
+        int i = which[k];
+        Cascade& cascade = cascades[i];
+        evolveShader->setFloat("time", times[k]);
+        evolveShader->setInt("n", cascade.size);
+        evolveShader->setInt("_Cascade", i);
+        glBindImageTexture(0, cascade.initialSpectrum, 0, GL_TRUE, 0, GL_READ_WRITE, InitialSpectrumFormat());
+        glBindImageTexture(1, cascade.spectrum, 0, GL_TRUE, 0, GL_READ_WRITE, SpectrumFormat());
+        glDispatchCompute(cascade.size / 16, cascade.size / 16, 1);
+    }
     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-  
 }
-void OceanFFTGenerator::IFFT(ComputeShader horizontal, ComputeShader vertical) {
-    int logSize = (int)log2(N);
+// Compiles stockhamFFT.cps for one size on first use. A whole line (one vec4 per texel) has to fit
+// in shared memory and size/4 invocations in one workgroup, otherwise that size keeps the old loop.
+const OceanFFTGenerator::StockhamFFT* OceanFFTGenerator::StockhamFor(int size) {
+    auto found = stockhamPrograms.find(size);
+    if (found == stockhamPrograms.end()) {
+        StockhamFFT& fft = stockhamPrograms[size];
+
+        GLint sharedMemory = 0, invocations = 0, sizeX = 0;
+        glGetIntegerv(GL_MAX_COMPUTE_SHARED_MEMORY_SIZE, &sharedMemory);
+        glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &invocations);
+        glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, 0, &sizeX);
+        int threads = size / 4;
+        if (size < 4 || (GLint)(size * 4 * sizeof(float)) > sharedMemory || threads > invocations || threads > sizeX) {
+            cout << "Stockham FFT unsupported at " << size << ", using the ping-pong FFT" << endl;
+        }
+        else {
+            int logSize = (int)log2(size);
+            // GLSL 4.30 wants a literal workgroup size, FFT_SIZE / 4 needs 4.40
+            std::string defines = FormatDefines() + "#define FFT_SIZE " + std::to_string(size) + "\n"
+                + "#define FFT_THREADS " + std::to_string(threads) + "\n";
+            if (logSize % 2 == 1)
+                defines += "#define FFT_RADIX2_STAGE\n";
+            fft.horizontal = std::make_unique<ComputeShader>("stockhamFFT.cps", defines + "#define HORIZONTAL\n");
+            fft.vertical = std::make_unique<ComputeShader>("stockhamFFT.cps", defines);
+            // the fused passes hold both spectrum layers of a line
+            if ((GLint)(2 * size * 4 * sizeof(float)) <= sharedMemory) {
+                fft.fusedHorizontal = std::make_unique<ComputeShader>("stockhamFFT.cps", defines + "#define HORIZONTAL\n#define FUSE_EVOLUTION\n");
+                fft.fusedVertical = std::make_unique<ComputeShader>("stockhamFFT.cps", defines + "#define FUSE_ASSEMBLE\n");
+            }
+        }
+        found = stockhamPrograms.find(size);
+    }
+    return found->second.horizontal ? &found->second : nullptr;
+}
+void OceanFFTGenerator::FreeStockhamFFT() {
+    for (auto& entry : stockhamPrograms) {
+        if (entry.second.horizontal) glDeleteProgram(entry.second.horizontal->ID);
+        if (entry.second.vertical) glDeleteProgram(entry.second.vertical->ID);
+        if (entry.second.fusedHorizontal) glDeleteProgram(entry.second.fusedHorizontal->ID);
+        if (entry.second.fusedVertical) glDeleteProgram(entry.second.fusedVertical->ID);
+    }
+    stockhamPrograms.clear();
+}
+void OceanFFTGenerator::FFTCascades(const std::vector<int>& which) {
+    // shared memory path: every cascade's rows, one barrier, every cascade's columns
+    bool anyStockham = false;
+    int rows = profiler ? profiler->Begin("ocean fft rows") : -1;
+    for (int i : which) {
+        Cascade& cascade = cascades[i];
+        const StockhamFFT* fft = useStockhamFFT ? StockhamFor(cascade.size) : nullptr;
+        if (!fft) continue;
+        // one workgroup per row/column, transformed in place in the spectrum array
+        glBindImageTexture(0, cascade.spectrum, 0, GL_TRUE, 0, GL_READ_WRITE, SpectrumFormat());
+        fft->horizontal->use();
+        glDispatchCompute(1, cascade.size, 2);
+        anyStockham = true;
+    }
+    if (profiler) profiler->End(rows);
+    if (anyStockham) {
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        GpuProfiler::Scope scope(profiler, "ocean fft columns");
+        for (int i : which) {
+            Cascade& cascade = cascades[i];
+            const StockhamFFT* fft = useStockhamFFT ? StockhamFor(cascade.size) : nullptr;
+            if (!fft) continue;
+            glBindImageTexture(0, cascade.spectrum, 0, GL_TRUE, 0, GL_READ_WRITE, SpectrumFormat());
+            fft->vertical->use();
+            glDispatchCompute(1, cascade.size, 2);
+        }
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+
+    for (int i : which) {
+        if (!useStockhamFFT || !StockhamFor(cascades[i].size))
+            PingPongFFT(cascades[i]);
+    }
+}
+void OceanFFTGenerator::PingPongFFT(Cascade& cascade) {
+    int size = cascade.size;
+    int logSize = (int)log2(size);
     bool pingPong = false;
+    if (cascade.pingPong == 0)
+        cascade.pingPong = CreateTextureArray(size, size, 2, ScratchFormat(), false);
 
    
 
-    glBindImageTexture(0, spectrumTextures, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA16F);
-    glBindImageTexture(1, pingPongTextures, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA16F);
-    glBindImageTexture(2, twiddleTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA16F);
-    horizontal.use();
-    int depth = DomainSizes.size() * 2;
+    glBindImageTexture(0, cascade.spectrum, 0, GL_TRUE, 0, GL_READ_WRITE, SpectrumFormat());
+    glBindImageTexture(1, cascade.pingPong, 0, GL_TRUE, 0, GL_READ_WRITE, ScratchFormat());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, ButterflyTables::Get(size));
+    horizontalShader->use();
 
+    int rows = profiler ? profiler->Begin("ocean fft rows") : -1;
     for (int i = 0; i < logSize; i++)
     {
         pingPong = !pingPong;
-        horizontal.setInt("Step", i);
-        horizontal.setBool("PingPong", pingPong);
-        glDispatchCompute( N / 8, N / 8, depth);
+        horizontalShader->setInt("Step", i);
+        horizontalShader->setBool("PingPong", pingPong);
+        glDispatchCompute(size / 8, size / 8, 2);
         glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
     }
 
-    vertical.use();
+    if (profiler) profiler->End(rows);
+    verticalShader->use();
 
+    GpuProfiler::Scope scope(profiler, "ocean fft columns");
     for (int i = 0; i < logSize; i++)
     {
         pingPong = !pingPong;
-        vertical.setInt("Step", i);
-        vertical.setBool("PingPong", pingPong);
-        glDispatchCompute(N / 8, N / 8,depth );
+        verticalShader->setInt("Step", i);
+        verticalShader->setBool("PingPong", pingPong);
+        glDispatchCompute(size / 8, size / 8, 2);
         glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
     }
 
     if (pingPong)
     {
         glCopyImageSubData(
-            pingPongTextures, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,  // Source
-            spectrumTextures, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,  // Destination
-            N, N, DomainSizes.size()*2  // Copy full texture array
+            cascade.pingPong, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,  // Source
+            cascade.spectrum, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,  // Destination
+            size, size, 2  // Copy full texture array
         );
 
     }
-
-    
-
-   
 }
-void OceanFFTGenerator::AssembleTextures(ComputeShader shader) {
-    shader.use();
-    glBindImageTexture(0, spectrumTextures, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA16F);
-    glBindImageTexture(1, displacementTextures, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA16F);
-    glBindImageTexture(2, slopeTextures, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RG16F);
-    glDispatchCompute(N / 16, N / 16, DomainSizes.size());
+void OceanFFTGenerator::AssembleCascades(const std::vector<int>& which, bool toKeys) {
+    if (which.empty()) return;
+    GpuProfiler::Scope scope(profiler, "ocean assemble");
+    assembleShader->use();
+    for (int i : which) {
+        Cascade& cascade = cascades[i];
+        BindAssembleTargets(*assembleShader, cascade, toKeys);
+        glDispatchCompute(cascade.size / 16, cascade.size / 16, 1);
+    }
+}
+// Uniforms and images 0-3 of fftNormalize.cps (and the fused vertical FFT) for one cascade:
+// displacement/slope to write, and the foam of its previous run to decay
+void OceanFFTGenerator::BindAssembleTargets(ShaderBase& shader, Cascade& cascade, bool toKeys) {
+    bool keyed = toKeys && cascade.interval > 1;
+    GLuint displacement = cascade.displacement, slope = cascade.slope;
+    // double buffered, last frame's foam lives in the front set
+    GLuint foamSource = cascade.frontDisplacement != 0 ? cascade.frontDisplacement : cascade.displacement;
+    // foam decays and builds up once per run, so a cascade running every n frames takes n steps at once
+    float rate = 1.0f;
+    if (keyed) {
+        displacement = cascade.keyDisplacement[cascade.writeSlot];
+        slope = cascade.keySlope[cascade.writeSlot];
+        if (cascade.keys > 0)
+            foamSource = cascade.keyDisplacement[cascade.newest];
+        rate = (float)cascade.interval;
+    }
+    shader.setVec2("_Lambda", frame.lambda);
+    shader.setFloat("_FoamBias", frame.foamBias);
+    shader.setFloat("_FoamThreshold", frame.foamThreshold);
+    shader.setFloat("_FoamDecayRate", frame.foamDecayRate * rate);
+    shader.setFloat("_FoamAdd", frame.foamAdd * rate);
+    glBindImageTexture(0, cascade.spectrum, 0, GL_TRUE, 0, GL_READ_ONLY, SpectrumFormat());
+    glBindImageTexture(1, displacement, 0, GL_TRUE, 0, GL_READ_WRITE, DisplacementFormat());
+    glBindImageTexture(2, slope, 0, GL_TRUE, 0, GL_WRITE_ONLY, SlopeFormat());
+    glBindImageTexture(3, foamSource, 0, GL_TRUE, 0, GL_READ_ONLY, DisplacementFormat());
+}
+// Evolution on load of the row pass, assembly as the epilogue of the column pass (stockhamFFT.cps
+// FUSE_EVOLUTION / FUSE_ASSEMBLE): two dispatches per cascade, spectrum written and read once.
+void OceanFFTGenerator::FusedCascades(const std::vector<int>& which, const std::vector<float>& times, bool toKeys) {
+    if (which.empty()) return;
+    int rows = profiler ? profiler->Begin("ocean fused evolve+rows") : -1;
+    for (size_t k = 0; k < which.size(); ++k) {
+        Cascade& cascade = cascades[which[k]];
+        ComputeShader& horizontal = *StockhamFor(cascade.size)->fusedHorizontal;
+        horizontal.use();
+        horizontal.setFloat("time", times[k]);
+        horizontal.setFloat("G", gravity);
+        horizontal.setFloat("RepeatTime", frame.repeatTime);
+        horizontal.setFloat("_DomainSize", (float)DomainSizes[which[k]]);
+        glBindImageTexture(0, cascade.spectrum, 0, GL_TRUE, 0, GL_WRITE_ONLY, SpectrumFormat());
+        glBindImageTexture(1, cascade.initialSpectrum, 0, GL_TRUE, 0, GL_READ_ONLY, InitialSpectrumFormat());
+        glDispatchCompute(1, cascade.size, 1);
+    }
+    if (profiler) profiler->End(rows);
     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-
- 
-
-    
+    GpuProfiler::Scope scope(profiler, "ocean fused columns+assemble");
+    for (int i : which) {
+        Cascade& cascade = cascades[i];
+        ComputeShader& vertical = *StockhamFor(cascade.size)->fusedVertical;
+        vertical.use();
+        BindAssembleTargets(vertical, cascade, toKeys);
+        glDispatchCompute(1, cascade.size, 1);
+    }
 }
-void  OceanFFTGenerator::setDomain(ShaderBase shader) {
-    glUniform1iv(glGetUniformLocation(shader.ID, "domains"), DomainSizes.size(), DomainSizes.data());
+// Evolve, FFT and assemble which at times, fused where stockhamFFT.cps allows it
+void OceanFFTGenerator::SimulateCascades(const std::vector<int>& which, const std::vector<float>& times, bool toKeys) {
+    std::vector<int> fused, separate;
+    std::vector<float> fusedTimes, separateTimes;
+    for (size_t k = 0; k < which.size(); ++k) {
+        const StockhamFFT* fft = useStockhamFFT && useFusedFFT ? StockhamFor(cascades[which[k]].size) : nullptr;
+        bool fuse = fft && fft->fusedHorizontal;
+        (fuse ? fused : separate).push_back(which[k]);
+        (fuse ? fusedTimes : separateTimes).push_back(times[k]);
+    }
+    EvolveCascades(separate, separateTimes);
+    FFTCascades(separate);
+    FusedCascades(fused, fusedTimes, toKeys);
+    AssembleCascades(separate, toKeys);
 }
-int const OceanFFTGenerator::DisplacementTexture () {
-    return displacementTextures;
+FusionBenchmark OceanFFTGenerator::BenchmarkFusion(float time, int frames) {
+    GLuint query;
+    glGenQueries(1, &query);
+    std::vector<int> all = AllCascades();
+    bool fusedSetting = useFusedFFT;
+    auto run = [&](bool fuse) {
+        useFusedFFT = fuse;
+        GLuint64 total = 0;
+        for (int f = 0; f < frames; ++f) {
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            SimulateCascades(all, std::vector<float>(all.size(), time + f / 60.0f), false);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            glEndQuery(GL_TIME_ELAPSED);
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            total += elapsed;
+        }
+        return total / 1e6 / frames;
+    };
+    FusionBenchmark result;
+    result.frames = frames;
+    result.separateMs = run(false);
+    result.fusedMs = run(true);
+    useFusedFFT = fusedSetting;
+    glDeleteQueries(1, &query);
+
+    int fusedCount = 0;
+    for (const Cascade& cascade : cascades) {
+        const StockhamFFT* fft = useStockhamFFT ? StockhamFor(cascade.size) : nullptr;
+        fusedCount += fft && fft->fusedHorizontal ? 1 : 0;
+    }
+    cout << "evolve+FFT+assemble: separate " << result.separateMs << " ms/frame, fused " << result.fusedMs
+        << " ms/frame (" << fusedCount << " of " << cascades.size() << " cascades fusable) over " << frames << " frames" << endl;
+    return result;
 }
-int const OceanFFTGenerator:: SlopeTexture() {
-    return slopeTextures;
+void OceanFFTGenerator::BlendCascades(float time) {
+    GpuProfiler::Scope scope(profiler, "ocean blend");
+    blendShader->use();
+    for (Cascade& cascade : cascades) {
+        if (cascade.interval == 1 || cascade.keys == 0) continue;
+
+        int older = cascade.keys > 1 ? 1 - cascade.newest : cascade.newest;
+        float span = cascade.keyTime[cascade.newest] - cascade.keyTime[older];
+        float blend = span > 0 ? glm::clamp((time - cascade.keyTime[older]) / span, 0.0f, 1.0f) : 1.0f;
+        BlendKeys(cascade, older, cascade.newest, blend);
+    }
 }
-void OceanFFTGenerator::bindTextures() {
-
-glBindTexture(GL_TEXTURE_2D_ARRAY, displacementTextures);
-    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
-    glBindTexture(GL_TEXTURE_2D_ARRAY, slopeTextures);
-    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
- //   glBindTexture(GL_TEXTURE_2D_ARRAY, initial_spectrumTextures);
- //   glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D_ARRAY, displacementTextures);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D_ARRAY, slopeTextures);
-    //glActiveTexture(GL_TEXTURE3);
-    //glBindTexture(GL_TEXTURE_2D_ARRAY, spectrumTextures);
-    //glActiveTexture(GL_TEXTURE4);
-    //glBindTexture(GL_TEXTURE_2D_ARRAY, initial_spectrumTextures);
-    //glActiveTexture(GL_TEXTURE5);
-    //glBindTexture(GL_TEXTURE_2D_ARRAY, twiddleTexture);
-  
+// displacement/slope = mix(key previous, key next, blend), blendShader has to be in use
+void OceanFFTGenerator::BlendKeys(Cascade& cascade, int previous, int next, float blend) {
+    blendShader->setFloat("_Blend", blend);
+    glBindImageTexture(0, cascade.keyDisplacement[previous], 0, GL_TRUE, 0, GL_READ_ONLY, DisplacementFormat());
+    glBindImageTexture(1, cascade.keyDisplacement[next], 0, GL_TRUE, 0, GL_READ_ONLY, DisplacementFormat());
+    glBindImageTexture(2, cascade.keySlope[previous], 0, GL_TRUE, 0, GL_READ_ONLY, SlopeFormat());
+    glBindImageTexture(3, cascade.keySlope[next], 0, GL_TRUE, 0, GL_READ_ONLY, SlopeFormat());
+    glBindImageTexture(4, cascade.displacement, 0, GL_TRUE, 0, GL_WRITE_ONLY, DisplacementFormat());
+    glBindImageTexture(5, cascade.slope, 0, GL_TRUE, 0, GL_WRITE_ONLY, SlopeFormat());
+    glDispatchCompute(cascade.size / 16, cascade.size / 16, 1);
 }
-void OceanFFTGenerator::RenderOcean() {
-    glPatchParameteri(GL_PATCH_VERTICES, 4);
-       glBindVertexArray(planeModel);
-       glDrawElements(GL_PATCHES, indices, GL_UNSIGNED_INT, 0);
-}
-
-void OceanFFTGenerator::defaultSpectrum(vector<Layer>& layers) {
-    DisplaySpectrumSettings settings[8];
-
-    // Spectrum 1
-    settings[0].scale = 0.1f;
-    settings[0].windSpeed = 2.0f;
-    settings[0].windDirection = 22.0f; // Assuming default value since it's not provided
-    settings[0].fetch = 100000.0f;
-    settings[0].spreadBlend = 0.642f; // Assuming default value since it's not provided
-    settings[0].swell = 1.0f;
-    settings[0].peakEnhancement = 1.0f;
-    settings[0].shortWavesFade = 0.025f;
-
-    // Spectrum 2
-    // Assuming default values for missing fields
-    settings[1].scale = 0.07f; // Not provided
-    settings[1].windSpeed = 2.0f; 
-    settings[1].windDirection = 59.0f; // Not provided
-    settings[1].fetch = 1000; // Not provided
-    settings[1].spreadBlend = 0.0f; // Not provided
-    settings[1].swell = 1.0f; // Not provided
-    settings[1].peakEnhancement = 1.0f; // Not provided
-    settings[1].shortWavesFade = 0.01f; // Not provided
-
-    // Spectrum 3
-    settings[2].scale = 0.25f;
-    settings[2].windSpeed = 20.0f;
-    settings[2].windDirection = 97.0f; // Assuming default value since it's not provided
-    settings[2].fetch = 1e+08f;
-    settings[2].spreadBlend = 0.14;
-    settings[2].swell = 1;
-    settings[2].peakEnhancement = 1.0f;
-    settings[2].shortWavesFade = 0.5f;
-
-    // Spectrum 4
-    settings[3].scale = 0.25f;
-    settings[3].windSpeed = 20.0f;
-    settings[3].windDirection = 67.0f; // Assuming default value since it's not provided
-    settings[3].fetch = 1000000.0f;
-    settings[3].spreadBlend = 0.47f;
-    settings[3].swell = 1.0f;
-    settings[3].peakEnhancement = 1.0f;
-    settings[3].shortWavesFade = 0.5f;
-
-    // Spectrum 5
-    settings[4].scale = 0.15f;
-    settings[4].windSpeed = 5.0f;
-    settings[4].windDirection = 105.0f; // Assuming default value since it's not provided
-    settings[4].fetch = 1000000.0f;
-    settings[4].spreadBlend = 0.2f; // Assuming default value since it's not provided
-    settings[4].swell = 1.0f;
-    settings[4].peakEnhancement = 1.0f;
-    settings[4].shortWavesFade = 0.5f;
-
-    // Spectrum 6
-    settings[5].scale = 0.1f;
-    settings[5].windSpeed = 1.0f; // Not provided
-    settings[5].windDirection = 19.0f; // Not provided
-    settings[5].fetch = 10000.0f;
-    settings[5].spreadBlend = 0.298f; // Not provided
-    settings[5].swell = 0.695f;
-    settings[5].peakEnhancement = 1.0f;
-    settings[5].shortWavesFade = 0.5f;
-
-    // Spectrum 7
-    settings[6].scale = 1.00f;
-    settings[6].windSpeed = 1.0f; // Not provided
-    settings[6].windDirection = 209.0f; // Not provided
-    settings[6].fetch = 200000.0f;
-    settings[6].spreadBlend = 0.56f; // Not provided
-    settings[6].swell = 1.0f;
-    settings[6].peakEnhancement = 1.0f;
-    settings[6].shortWavesFade = 0.0001f;
-
-    // Spectrum 8
-    settings[7].scale = 0.23f;
-    settings[7].windSpeed = 1.0f; // Not provided
-    settings[7].windDirection = 0.0f; // Not provided
-    settings[7].fetch = 1000.0f;
-    settings[7].spreadBlend = 0.0f; // Not provided
-    settings[7].swell = 0.0f;
-    settings[7].peakEnhancement = 1.0f;
-    settings[7].shortWavesFade = 0.0001f;
-
-    // Now you can use the settings array for debugging or further processing
-    for (int i = 0; i < 8; ++i) {
-        SpectrumSettings computeSettings;
-        FillSpectrumStruct(settings[i], computeSettings);
-        spectrums.push_back(computeSettings);
+// Runs the pipeline at frameRate over one RepeatTime period and writes every step's outputs.
+// Foam decays and builds up once per step, so its rates are scaled from 60 steps a second to frameRate.
+bool OceanFFTGenerator::BakeSequence(const std::string& path, float frameRate) {
+    if (cascades.empty() || frameRate <= 0)
+        return false;
+    CalculateSpectrum();
+    FreeFrontOutputs();
+
+    OceanSequence::Header header;
+    header.cascadeCount = glm::min((int)cascades.size(), MAX_CASCADES);
+    for (int c = 0; c < header.cascadeCount; ++c)
+        header.sizes[c] = cascades[c].size;
+    header.repeatTime = frame.repeatTime;
+    header.frameCount = glm::max(1, (int)ceil(frame.repeatTime * frameRate));
+    // whole frames per period, so the last frame blends into the first
+    header.frameRate = header.frameCount / frame.repeatTime;
+    float step = 1.0f / header.frameRate;
+
+    OceanSequence::Writer writer;
+    if (!writer.Open(path, header)) {
+        cout << "can't write " << path << endl;
+        return false;
     }
-   
-    DomainSizes = { 94,128,64,32 };
-    layers.resize(4); 
- for (int index = 0; index < 4; ++index) {
-        layers[index].DomainSize = DomainSizes[index];
-        layers[index].spec1 = settings[index * 2];
-        layers[index].spec2 = settings[index * 2 + 1];
+    perFrameParameters saved = frame;
+    frame.foamDecayRate *= step * 60.0f;
+    frame.foamAdd *= step * 60.0f;
+
+    auto run = [&](float time) {
+        EvolveSpectrum(time);
+        IFFT();
+        AssembleTextures();
+    };
+    // start a few seconds before the end of the period so foam at frame 0 continues the last frame
+    int warmup = glm::min(header.frameCount, (int)ceil(4.0f / step));
+    for (int w = 0; w < warmup; ++w)
+        run(frame.repeatTime - (warmup - w) * step);
+
+    std::vector<std::vector<uint16_t>> words(header.cascadeCount);
+    for (int f = 0; f < header.frameCount; ++f) {
+        run(f * step);
+        for (int c = 0; c < header.cascadeCount; ++c) {
+            const Cascade& cascade = cascades[c];
+            size_t texels = (size_t)cascade.size * cascade.size;
+            words[c].resize(OceanSequence::CascadeWords(cascade.size));
+            glGetTextureImage(cascade.displacement, 0, GL_RGBA, GL_HALF_FLOAT, GLsizei(texels * 8), words[c].data());
+            glGetTextureImage(cascade.slope, 0, GL_RG, GL_HALF_FLOAT, GLsizei(texels * 4), words[c].data() + texels * 4);
+        }
+        writer.Append(words);
     }
-}
+    frame = saved;
 
+    uint64_t bytes = writer.Finish();
+    cout << "baked " << header.frameCount << " frames at " << header.frameRate << " fps into " << path << ", "
+        << bytes / (1024.0 * 1024.0) << " MB" << endl;
+    return bytes > 0;
+}
+bool OceanFFTGenerator::LoadSequence(const std::string& path) {
+    auto reader = std::make_unique<OceanSequence::Reader>();
+    if (!reader->Open(path)) {
+        cout << "can't read ocean sequence " << path << endl;
+        return false;
+    }
+    sequence = std::move(reader);
+    sequenceSlots[0] = sequenceSlots[1] = -1;
+    if (!SequenceMatches())
+        cout << "ocean sequence " << path << " was baked with other cascade sizes, bake it again to play it" << endl;
+    return true;
+}
+bool OceanFFTGenerator::SequenceMatches() const {
+    if (!sequence)
+        return false;
+    const OceanSequence::Header& info = sequence->Info();
+    if (info.cascadeCount != (int)cascades.size())
+        return false;
+    for (int c = 0; c < info.cascadeCount; ++c)
+        if (info.sizes[c] != cascades[c].size)
+            return false;
+    return true;
+}
+// Uploads the sequence frames before and after time into the cascade keys (only the one that
+// changed when playback moves on by a frame) and blends them into the displayed outputs.
+void OceanFFTGenerator::PlaySequence(float time) {
+    FreeFrontOutputs();
+    const OceanSequence::Header& info = sequence->Info();
+    float position = fmod(time, info.repeatTime) * info.frameRate;
+    if (position < 0)
+        position += info.frameCount;
+    int previous = glm::min((int)position, info.frameCount - 1);
+    int next = (previous + 1) % info.frameCount;
+    float blend = glm::clamp(position - previous, 0.0f, 1.0f);
+
+    for (Cascade& cascade : cascades) {
+        if (cascade.keyDisplacement[0] == 0)
+            AllocateKeys(cascade);
+        // the scheduler starts over once playback stops
+        cascade.keys = 0;
+    }
+    int previousSlot = sequenceSlots[1] == previous ? 1 : 0;
+    int nextSlot = 1 - previousSlot;
+    int wanted[2];
+    wanted[previousSlot] = previous;
+    wanted[nextSlot] = next;
+    for (int slot = 0; slot < 2; ++slot) {
+        if (sequenceSlots[slot] == wanted[slot])
+            continue;
+        const std::vector<std::vector<uint16_t>>* words = sequence->Frame(wanted[slot]);
+        if (!words) {
+            cout << "ocean sequence frame " << wanted[slot] << " is damaged, playback stopped" << endl;
+            playSequence = false;
+            sequenceSlots[0] = sequenceSlots[1] = -1;
+            return;
+        }
+        for (int c = 0; c < info.cascadeCount; ++c) {
+            Cascade& cascade = cascades[c];
+            size_t texels = (size_t)cascade.size * cascade.size;
+            glTextureSubImage3D(cascade.keyDisplacement[slot], 0, 0, 0, 0, cascade.size, cascade.size, 1,
+                GL_RGBA, GL_HALF_FLOAT, (*words)[c].data());
+            glTextureSubImage3D(cascade.keySlope[slot], 0, 0, 0, 0, cascade.size, cascade.size, 1,
+                GL_RG, GL_HALF_FLOAT, (*words)[c].data() + texels * 4);
+        }
+        sequenceSlots[slot] = wanted[slot];
+    }
 
+    GpuProfiler::Scope scope(profiler, "ocean blend");
+    blendShader->use();
+    for (Cascade& cascade : cascades)
+        BlendKeys(cascade, previousSlot, nextSlot, blend);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+ScheduleBenchmark OceanFFTGenerator::BenchmarkSchedule(float time, int frames) {
+    const float frameTime = 1.0f / 60.0f;
+    frames = glm::max(frames, 1);
+    // the frames' Updates move the schedule on as they would live
+    unsigned savedUpdateFrame = updateFrame;
+    float savedLastUpdateTime = lastUpdateTime, savedAverageFrameTime = averageFrameTime;
+
+    // a timestamp pair per frame (some drivers, llvmpipe, only tick those), read once all are
+    // submitted so the CPU never waits on the GPU in between
+    std::vector<GLuint> queries(2 * frames);
+    glGenQueries(2 * frames, queries.data());
+    auto run = [&]() {
+        for (int f = 0; f < frames; ++f) {
+            glQueryCounter(queries[2 * f], GL_TIMESTAMP);
+            Update(time + f * frameTime);
+            glQueryCounter(queries[2 * f + 1], GL_TIMESTAMP);
+        }
+        GLuint64 total = 0;
+        for (int f = 0; f < frames; ++f) {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(queries[2 * f], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(queries[2 * f + 1], GL_QUERY_RESULT, &end);
+            total += end - begin;
+        }
+        return total / 1e6 / frames;
+    };
 
-void OceanFFTGenerator::createFFTWaterPlane(const int SIZE) {
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
+    ScheduleBenchmark result;
+    result.frames = frames;
+    result.scheduledMs = run();
+    int intervals[MAX_CASCADES];
+    std::copy(frame.updateInterval, frame.updateInterval + MAX_CASCADES, intervals);
+    std::fill(frame.updateInterval, frame.updateInterval + MAX_CASCADES, 1);
+    result.fullRateMs = run();
+    std::copy(intervals, intervals + MAX_CASCADES, frame.updateInterval);
+    glDeleteQueries(2 * frames, queries.data());
+
+    updateFrame = savedUpdateFrame;
+    lastUpdateTime = savedLastUpdateTime;
+    averageFrameTime = savedAverageFrameTime;
+    // the keys now hold the benchmark's times, the next Update evaluates them again at its own
+    for (Cascade& cascade : cascades)
+        cascade.keys = 0;
+
+    cout << "schedule";
+    for (int i = 0; i < (int)cascades.size() && i < MAX_CASCADES; ++i)
+        cout << " 1/" << frame.updateInterval[i];
+    cout << ": " << result.scheduledMs << " ms/frame, full rate " << result.fullRateMs << " ms/frame over " << frames << " frames" << endl;
+    return result;
+}
+// Bytes EvolveSpectrum, IFFT and AssembleTextures move through image load/store per frame at the
+// current size with the given policy, counting every access (no cache hits, no mip generation).
+double OceanFFTGenerator::FrameBandwidth(const OceanPrecision& policy) {
+    auto rgba = [](bool fp32) { return fp32 ? 16.0 : 8.0; };
+    double initial = rgba(policy.initialSpectrum);
+    double spectrum = rgba(policy.evolvedSpectrum);
+    double scratch = rgba(policy.fftScratch);
+    double twiddle = 16.0;   // FP32 twiddle + two int indices
+    double displacement = rgba(policy.outputs);
+    double slope = policy.outputs ? 8.0 : 4.0;
+
+    double bytes = 0;
+    for (const Cascade& cascade : cascades) {
+        double texels = double(cascade.size) * cascade.size;
+        bytes += texels * (initial + 2 * spectrum);   // evolve: one initial texel in, two spectrum layers out
+
+        if (useStockhamFFT && StockhamFor(cascade.size)) {
+            bytes += 2 * (2 * texels) * (2 * spectrum);     // two directions, both layers loaded and stored once
+        }
+        else {
+            // each step loads two inputs and a twiddle and stores one output, alternating spectrum -> scratch -> spectrum
+            double stepPair = (2 * spectrum + twiddle + scratch) + (2 * scratch + twiddle + spectrum);
+            bytes += (2 * texels) * stepPair * log2(cascade.size);
+        }
 
-    // Generate vertices
-    for (int z = 0; z < SIZE; ++z) {
-        for (int x = 0; x < SIZE; ++x) {
-            float xPos = (x - SIZE / 2)*5;
-            float zPos = (z - SIZE / 2)*5;
+        bytes += texels * (2 * spectrum + 2 * displacement + slope);   // assemble: foam is read back
+    }
+    return bytes;
+}
+// every cascade's level 0, one after the other
+void OceanFFTGenerator::ReadOutputs(std::vector<float>& displacement, std::vector<float>& slope) {
+    size_t texels = 0;
+    for (const Cascade& cascade : cascades)
+        texels += size_t(cascade.size) * cascade.size;
+    displacement.resize(texels * 4);
+    slope.resize(texels * 2);
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+    size_t offset = 0;
+    for (const Cascade& cascade : cascades) {
+        size_t count = size_t(cascade.size) * cascade.size;
+        glGetTextureImage(cascade.displacement, 0, GL_RGBA, GL_FLOAT, GLsizei(count * 4 * sizeof(float)), displacement.data() + offset * 4);
+        glGetTextureImage(cascade.slope, 0, GL_RG, GL_FLOAT, GLsizei(count * 2 * sizeof(float)), slope.data() + offset * 2);
+        offset += count;
+    }
+}
+std::vector<PrecisionMeasurement> OceanFFTGenerator::MeasurePrecision(perChangeParameters parameters, float time) {
+    OceanPrecision requested = parameters.precision;
+    std::vector<float> referenceDisplacement, referenceSlope, displacement, slope;
+
+    auto runFrame = [&](const OceanPrecision& policy, std::vector<float>& displacementOut, std::vector<float>& slopeOut) {
+        parameters.precision = policy;
+        InitialBake(parameters);
+        CalculateSpectrum();
+        EvolveSpectrum(time);
+        IFFT();
+        AssembleTextures();
+        ReadOutputs(displacementOut, slopeOut);
+    };
 
-            vertices.push_back(xPos);
-            vertices.push_back(0);
-            vertices.push_back(zPos);
+    OceanPrecision fp32;
+    fp32.initialSpectrum = fp32.evolvedSpectrum = fp32.fftScratch = fp32.outputs = true;
+    runFrame(fp32, referenceDisplacement, referenceSlope);
+
+    // scratch only exists on the ping-pong path
+    bool pingPongFFT = false;
+    for (const Cascade& cascade : cascades)
+        pingPongFFT = pingPongFFT || !useStockhamFFT || !StockhamFor(cascade.size);
+    const OceanPrecision defaults;
+
+    std::vector<PrecisionMeasurement> results;
+    for (int mask = 0; mask < 16; ++mask) {
+        OceanPrecision policy;
+        policy.initialSpectrum = (mask & 1) != 0;
+        policy.evolvedSpectrum = (mask & 2) != 0;
+        policy.fftScratch = (mask & 4) != 0;
+        policy.outputs = (mask & 8) != 0;
+        if (!pingPongFFT && policy.fftScratch != defaults.fftScratch)
+            continue;
+
+        runFrame(policy, displacement, slope);
+
+        PrecisionMeasurement result = {};
+        result.precision = policy;
+        result.megabytesPerFrame = FrameBandwidth(policy) / (1024.0 * 1024.0);
+        double displacementSum = 0, slopeSum = 0, foamSum = 0;
+        size_t texels = displacement.size() / 4;
+        for (size_t t = 0; t < texels; ++t) {
+            for (int c = 0; c < 3; ++c) {
+                double error = displacement[t * 4 + c] - referenceDisplacement[t * 4 + c];
+                displacementSum += error * error;
+                result.displacementMax = glm::max(result.displacementMax, glm::abs(error));
+            }
+            double foamError = displacement[t * 4 + 3] - referenceDisplacement[t * 4 + 3];
+            foamSum += foamError * foamError;
+            for (int c = 0; c < 2; ++c) {
+                double error = slope[t * 2 + c] - referenceSlope[t * 2 + c];
+                slopeSum += error * error;
+                result.slopeMax = glm::max(result.slopeMax, glm::abs(error));
+            }
         }
+        result.displacementRMS = sqrt(displacementSum / (texels * 3));
+        result.slopeRMS = sqrt(slopeSum / (texels * 2));
+        result.foamRMS = sqrt(foamSum / texels);
+        results.push_back(result);
     }
 
-    //// Generate indices for a grid
-    //for (int z = 0; z < SIZE - 1; ++z) {
-    //    for (int x = 0; x < SIZE - 1; ++x) {
-    //        int topLeft = z * SIZE + x;
-    //        int topRight = topLeft + 1;
-    //        int bottomLeft = (z + 1) * SIZE + x;
-    //        int bottomRight = bottomLeft + 1;
-
-    //        // First triangle
-    //        indices.push_back(topLeft);
-    //        indices.push_back(bottomLeft);
-    //        indices.push_back(topRight);
-
-    //        // Second triangle
-    //        indices.push_back(topRight);
-    //        indices.push_back(bottomLeft);
-    //        indices.push_back(bottomRight);
-    //    }
-    //}
-    
-    // Generate indices for quad patches (4 vertices per quad)
-    for (int z = 0; z < SIZE - 1; ++z) {
-        for (int x = 0; x < SIZE - 1; ++x) {
-            int topLeft = z * SIZE + x;
-            int topRight = topLeft + 1;
-            int bottomLeft = (z + 1) * SIZE + x;
-            int bottomRight = bottomLeft + 1;
+    parameters.precision = requested;
+    InitialBake(parameters);
+    CalculateSpectrum();
+
+    cout << "precision at";
+    for (const Cascade& cascade : cascades)
+        cout << ' ' << cascade.size;
+    cout << (pingPongFFT ? " (ping-pong FFT)" : " (shared memory FFT)") << endl;
+    cout << "initial,evolved,scratch,outputs,MB/frame,dispRMS,dispMax,slopeRMS,slopeMax,foamRMS" << endl;
+    for (const PrecisionMeasurement& result : results) {
+        const OceanPrecision& p = result.precision;
+        cout << (p.initialSpectrum ? 32 : 16) << ',' << (p.evolvedSpectrum ? 32 : 16) << ',' << (p.fftScratch ? 32 : 16) << ','
+             << (p.outputs ? 32 : 16) << ',' << result.megabytesPerFrame << ','
+             << result.displacementRMS << ',' << result.displacementMax << ',' << result.slopeRMS << ',' << result.slopeMax << ','
+             << result.foamRMS << endl;
+    }
+    return results;
+}
+std::vector<AccuracyMeasurement> OceanFFTGenerator::MeasureAccuracy(perChangeParameters parameters, const std::vector<int>& seeds,
+    const std::vector<float>& times, int timingFrames) {
+    OceanPrecision requested = parameters.precision;
+    int requestedSeed = parameters.seed;
+    bool stockhamSetting = useStockhamFFT, fusedSetting = useFusedFFT, cacheSetting = useSpectrumCache;
+    // the shaders are under test, not the cache
+    useSpectrumCache = false;
+
+    struct Variant {
+        const char* name;
+        bool stockham, fused;
+    };
+    const Variant variants[] = { { "ping-pong", false, false }, { "stockham", true, false }, { "fused", true, true } };
+    OceanPrecision fp32;
+    fp32.initialSpectrum = fp32.evolvedSpectrum = fp32.fftScratch = fp32.outputs = true;
+    const OceanPrecision policies[] = { OceanPrecision(), fp32 };
+
+    auto readLayers = [](GLuint texture, int size, int layers, std::vector<float>& texels) {
+        texels.resize((size_t)size * size * layers * 4);
+        glGetTextureImage(texture, 0, GL_RGBA, GL_FLOAT, GLsizei(texels.size() * sizeof(float)), texels.data());
+    };
+    auto toDouble = [](const std::vector<float>& texels, std::vector<glm::dvec4>& out) {
+        out.resize(texels.size() / 4);
+        for (size_t t = 0; t < out.size(); ++t)
+            out[t] = glm::dvec4(texels[t * 4], texels[t * 4 + 1], texels[t * 4 + 2], texels[t * 4 + 3]);
+    };
 
-            // Expected order: bottom-left, bottom-right, top-left, top-right
-            indices.push_back(bottomLeft);  // gl_in[0]
-            indices.push_back(bottomRight); // gl_in[1]
-            indices.push_back(topLeft);     // gl_in[2]
-            indices.push_back(topRight);    // gl_in[3]
+    // timestamps rather than GL_TIME_ELAPSED, some drivers (llvmpipe) only tick the former
+    GLuint queries[2];
+    glGenQueries(2, queries);
+    std::vector<int> all = AllCascades();
+    std::vector<AccuracyMeasurement> results;
+    std::vector<float> texels, previousFoam, displacement, slope;
+    std::vector<glm::dvec4> initial, evolved, referenceDisplacement, referenceSpectrum;
+    std::vector<glm::dvec2> referenceSlope;
+    std::vector<double> foam;
+    for (const OceanPrecision& policy : policies) {
+        for (const Variant& variant : variants) {
+            useStockhamFFT = variant.stockham;
+            useFusedFFT = variant.fused;
+            size_t first = results.size();
+            double gpuMs = -1;
+            for (int seed : seeds) {
+                parameters.precision = policy;
+                parameters.seed = seed;
+                InitialBake(parameters);
+                CalculateSpectrum();
+
+                // the initial spectrum doesn't change with time
+                glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+                oceanReference::ErrorAccumulator initialError;
+                std::vector<std::vector<glm::dvec4>> gpuInitial(cascades.size());
+                for (int i : all) {
+                    Cascade& cascade = cascades[i];
+                    readLayers(cascade.initialSpectrum, cascade.size, 1, texels);
+                    toDouble(texels, gpuInitial[i]);
+                    oceanReference::BakeSettings bake = { cascade.size, i, (double)DomainSizes[i], gravity, Depth,
+                        lowCutOff, highCutOff, seed, &spectrums[i * 2], &spectrums[i * 2 + 1] };
+                    oceanReference::InitialSpectrum(bake, initial);
+                    for (size_t t = 0; t < initial.size(); ++t)
+                        for (int c = 0; c < 4; ++c)
+                            initialError.Add(gpuInitial[i][t][c], initial[t][c]);
+                }
+
+                for (float time : times) {
+                    AccuracyMeasurement result = {};
+                    result.variant = variant.name;
+                    result.precision = policy;
+                    result.seed = seed;
+                    result.time = time;
+                    result.initialSpectrum = initialError.Result();
+
+                    // foam decays from whatever the last frame left
+                    std::vector<std::vector<float>> foamBefore(cascades.size());
+                    for (int i : all) {
+                        Cascade& cascade = cascades[i];
+                        readLayers(cascade.frontDisplacement != 0 ? cascade.frontDisplacement : cascade.displacement, cascade.size, 1, texels);
+                        foamBefore[i].resize((size_t)cascade.size * cascade.size);
+                        for (size_t t = 0; t < foamBefore[i].size(); ++t)
+                            foamBefore[i][t] = texels[t * 4 + 3];
+                    }
+
+                    std::vector<float> cascadeTimes(all.size(), time);
+                    oceanReference::ErrorAccumulator evolvedError;
+                    if (variant.fused) {
+                        SimulateCascades(all, cascadeTimes, false);
+                    }
+                    else {
+                        EvolveCascades(all, cascadeTimes);
+                        glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+                        for (int i : all) {
+                            Cascade& cascade = cascades[i];
+                            readLayers(cascade.spectrum, cascade.size, 2, texels);
+                            oceanReference::EvolveSpectrum(cascade.size, DomainSizes[i], gravity, frame.repeatTime, time, gpuInitial[i], evolved);
+                            for (size_t t = 0; t < evolved.size(); ++t)
+                                for (int c = 0; c < 4; ++c)
+                                    evolvedError.Add(texels[t * 4 + c], evolved[t][c]);
+                        }
+                        FFTCascades(all);
+                        AssembleCascades(all, false);
+                    }
+                    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+                    ReadOutputs(displacement, slope);
+                    result.evolvedSpectrum = evolvedError.Result();
+
+                    oceanReference::ErrorAccumulator displacementError, slopeError, foamError;
+                    size_t offset = 0;
+                    for (int i : all) {
+                        Cascade& cascade = cascades[i];
+                        oceanReference::EvolveSpectrum(cascade.size, DomainSizes[i], gravity, frame.repeatTime, time, gpuInitial[i], referenceSpectrum);
+                        oceanReference::IFFT(cascade.size, referenceSpectrum);
+                        foam.assign(foamBefore[i].begin(), foamBefore[i].end());
+                        oceanReference::Assemble(cascade.size, referenceSpectrum, frame, foam, referenceDisplacement, referenceSlope);
+                        for (size_t t = 0; t < referenceDisplacement.size(); ++t) {
+                            for (int c = 0; c < 3; ++c)
+                                displacementError.Add(displacement[(offset + t) * 4 + c], referenceDisplacement[t][c]);
+                            foamError.Add(displacement[(offset + t) * 4 + 3], referenceDisplacement[t].w);
+                            for (int c = 0; c < 2; ++c)
+                                slopeError.Add(slope[(offset + t) * 2 + c], referenceSlope[t][c]);
+                        }
+                        offset += referenceDisplacement.size();
+                    }
+                    result.displacement = displacementError.Result();
+                    result.slope = slopeError.Result();
+                    result.foam = foamError.Result();
+                    results.push_back(result);
+                }
+
+                // timed once per variant, on the first seed's bake
+                if (gpuMs < 0) {
+                    GLuint64 total = 0;
+                    for (int f = 0; f < timingFrames; ++f) {
+                        glQueryCounter(queries[0], GL_TIMESTAMP);
+                        SimulateCascades(all, std::vector<float>(all.size(), f / 60.0f), false);
+                        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+                        glQueryCounter(queries[1], GL_TIMESTAMP);
+                        GLuint64 begin = 0, end = 0;
+                        glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &begin);
+                        glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &end);
+                        total += end - begin;
+                    }
+                    gpuMs = timingFrames > 0 ? total / 1e6 / timingFrames : 0.0;
+                }
+            }
+            for (size_t r = first; r < results.size(); ++r)
+                results[r].gpuMs = gpuMs;
+        }
+    }
+    glDeleteQueries(2, queries);
+
+    useStockhamFFT = stockhamSetting;
+    useFusedFFT = fusedSetting;
+    parameters.precision = requested;
+    parameters.seed = requestedSeed;
+    InitialBake(parameters);
+    CalculateSpectrum();
+    useSpectrumCache = cacheSetting;
+
+    cout << "accuracy against FP64 at";
+    for (const Cascade& cascade : cascades)
+        cout << ' ' << cascade.size;
+    cout << endl;
+    cout << "variant,precision,seed,time,gpuMs,initialMax,initialRMS,evolvedMax,evolvedRMS,dispMax,dispRMS,slopeMax,slopeRMS,foamMax" << endl;
+    for (const AccuracyMeasurement& result : results) {
+        cout << result.variant << ',' << (result.precision == fp32 ? "fp32" : "default") << ',' << result.seed << ',' << result.time << ','
+             << result.gpuMs << ',' << result.initialSpectrum.maxError << ',' << result.initialSpectrum.rmsError << ','
+             << result.evolvedSpectrum.maxError << ',' << result.evolvedSpectrum.rmsError << ','
+             << result.displacement.maxError << ',' << result.displacement.rmsError << ','
+             << result.slope.maxError << ',' << result.slope.rmsError << ',' << result.foam.maxError << endl;
+    }
+    return results;
+}
+void  OceanFFTGenerator::setDomain(ShaderBase shader) {
+    glUniform1iv(glGetUniformLocation(shader.ID, "domains"), DomainSizes.size(), DomainSizes.data());
+}
+void OceanFFTGenerator::setSamplers(ShaderBase shader, const char* displacementName, const char* slopeName) {
+    GLint units[MAX_CASCADES];
+    for (int i = 0; i < MAX_CASCADES; ++i)
+        units[i] = DISPLACEMENT_TEXTURE_UNIT + i;
+    glProgramUniform1iv(shader.ID, glGetUniformLocation(shader.ID, displacementName), MAX_CASCADES, units);
+    if (slopeName) {
+        for (int i = 0; i < MAX_CASCADES; ++i)
+            units[i] = SLOPE_TEXTURE_UNIT + i;
+        glProgramUniform1iv(shader.ID, glGetUniformLocation(shader.ID, slopeName), MAX_CASCADES, units);
+    }
+}
+void OceanFFTGenerator::setTileSizes(ShaderBase shader, const char* name) {
+    GLfloat sizes[MAX_CASCADES] = { 1, 1, 1, 1 };
+    for (int i = 0; i < (int)DomainSizes.size() && i < MAX_CASCADES; ++i)
+        sizes[i] = CascadeTileSize(i);
+    glProgramUniform1fv(shader.ID, glGetUniformLocation(shader.ID, name), MAX_CASCADES, sizes);
+}
+int OceanFFTGenerator::DisplacementTexture(int cascade) {
+    const Cascade& c = cascades[cascade];
+    return c.frontDisplacement != 0 ? c.frontDisplacement : c.displacement;
+}
+int OceanFFTGenerator::SlopeTexture(int cascade) {
+    const Cascade& c = cascades[cascade];
+    return c.frontSlope != 0 ? c.frontSlope : c.slope;
+}
+int OceanFFTGenerator::CascadeSize(int cascade) {
+    return cascades[cascade].size;
+}
+void OceanFFTGenerator::bindTextures() {
 
+    // mips are built by BuildMips when the outputs are written
+    for (int i = 0; i < (int)cascades.size(); ++i) {
+        glActiveTexture(GL_TEXTURE0 + DISPLACEMENT_TEXTURE_UNIT + i);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, DisplacementTexture(i));
+        glActiveTexture(GL_TEXTURE0 + SLOPE_TEXTURE_UNIT + i);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, SlopeTexture(i));
+    }
+    glActiveTexture(GL_TEXTURE0);
+  
+}
+void OceanFFTGenerator::RenderOcean(ShaderBase& shader, const glm::vec3& cameraPos, const glm::mat4& viewProjection) {
+    glm::vec2 origins[MAX_CLIPMAP_LEVELS];
+    for (int level = 0; level < clipmapLevels; ++level) {
+        float patch = clipmapPatchSize * float(1 << level);
+        // snapped to two patches: the next level snaps to two of its own, so the hole this level
+        // leaves in it always falls on its patch grid (patchesPerSide / 2 stays even)
+        origins[level] = glm::floor(glm::vec2(cameraPos.x, cameraPos.z) / (2.0f * patch)) * (2.0f * patch)
+            - float(clipmapPatches / 2) * patch;
+    }
+    for (GLuint program : { cullShader->ID, shader.ID }) {
+        glProgramUniform2fv(program, glGetUniformLocation(program, "_RingOrigins"), clipmapLevels, glm::value_ptr(origins[0]));
+        glProgramUniform1f(program, glGetUniformLocation(program, "_RingPatchSize"), clipmapPatchSize);
+        glProgramUniform1i(program, glGetUniformLocation(program, "_RingPatches"), clipmapPatches);
+        glProgramUniform1i(program, glGetUniformLocation(program, "_RingLevels"), clipmapLevels);
+        glProgramUniform1i(program, glGetUniformLocation(program, "_TilePatches"), CLIPMAP_TILE_PATCHES);
+        glProgramUniform1f(program, glGetUniformLocation(program, "_EarthRadius"), earthRadius);
+    }
 
-        }
+    {
+        GpuProfiler::Scope scope(profiler, "ocean cull");
+        // count stays one tile's indices, instanceCount restarts from 0
+        const GLuint command[5] = { 4 * CLIPMAP_TILE_PATCHES * CLIPMAP_TILE_PATCHES, 0, 0, 0, 0 };
+        glNamedBufferSubData(drawCommand, 0, sizeof(command), command);
+        cullShader->use();
+        cullShader->setMat4("_ViewProjection", viewProjection);
+        cullShader->setVec3("_CameraPos", cameraPos);
+        cullShader->setInt("_CullPatches", cullPatches);
+        cullShader->setInt("_Cascades", glm::min((int)cascades.size(), MAX_CASCADES));
+        cullShader->setFloat("_DisplacementSigmas", DISPLACEMENT_SIGMAS * glm::max(displacementScale, 0.0f));
+        cullShader->setFloat("_Lambda", glm::max(frame.lambda.x, frame.lambda.y));
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, patchBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, drawCommand);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, heightVarianceBuffer);
+        int tilesPerSide = clipmapPatches / CLIPMAP_TILE_PATCHES;
+        int tiles = clipmapLevels * tilesPerSide * tilesPerSide;
+        glDispatchCompute((tiles + 63) / 64, 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
     }
 
-    // Upload to OpenGL
-    glGenVertexArrays(1, &planeModel);
+    shader.use();
+    glPatchParameteri(GL_PATCH_VERTICES, 4);
     glBindVertexArray(planeModel);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommand);
+    glDrawElementsIndirect(GL_PATCHES, GL_UNSIGNED_SHORT, nullptr);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+float OceanFFTGenerator::ClipmapRadius() const {
+    return 0.5f * clipmapPatches * clipmapPatchSize * float(1 << glm::max(clipmapLevels - 1, 0));
+}
 
-    GLuint VBO, EBO;
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+void OceanFFTGenerator::createClipmap(int levels, int patchesPerSide, float patchSize) {
+    clipmapLevels = glm::clamp(levels, 1, MAX_CLIPMAP_LEVELS);
+    clipmapPatches = glm::max(CLIPMAP_TILE_PATCHES, patchesPerSide / CLIPMAP_TILE_PATCHES * CLIPMAP_TILE_PATCHES);
+    clipmapPatchSize = patchSize;
+    if (!cullShader)
+        cullShader = std::make_unique<ComputeShader>("oceanPatchCull.cps");
+
+    if (planeModel == 0) {
+        // the tile's patches, over (CLIPMAP_TILE_PATCHES + 1)^2 vertices numbered row by row from -x -z;
+        // oceanFFT.vert turns the index back into the corner and scales and moves it per instance
+        // Expected order per patch: bottom-left, bottom-right, top-left, top-right (bottom is +z)
+        const int row = CLIPMAP_TILE_PATCHES + 1;
+        std::vector<GLushort> indices;
+        indices.reserve(4 * CLIPMAP_TILE_PATCHES * CLIPMAP_TILE_PATCHES);
+        for (int z = 0; z < CLIPMAP_TILE_PATCHES; ++z) {
+            for (int x = 0; x < CLIPMAP_TILE_PATCHES; ++x) {
+                GLushort topLeft = (GLushort)(z * row + x);
+                GLushort bottomLeft = (GLushort)(topLeft + row);
+                indices.insert(indices.end(), { bottomLeft, (GLushort)(bottomLeft + 1), topLeft, (GLushort)(topLeft + 1) });
+            }
+        }
 
-    // Upload vertex data
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        glGenVertexArrays(1, &planeModel);
+        glBindVertexArray(planeModel);
 
-    // Upload index data
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        GLuint EBO;
+        glGenBuffers(1, &EBO);
+        glCreateBuffers(1, &patchBuffer);
+        glCreateBuffers(1, &drawCommand);
 
-    // Define vertex attributes
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
 
-    // Store the number of indices for rendering
-    this->indices = indices.size();
+        // one tile of the cull pass's list per instance
+        glBindBuffer(GL_ARRAY_BUFFER, patchBuffer);
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+        glVertexAttribDivisor(3, 1);
+        glEnableVertexAttribArray(3);
+        glBindVertexArray(0);
+    }
+    // room for every tile of every level, the cull pass writes no more than that
+    int tilesPerSide = clipmapPatches / CLIPMAP_TILE_PATCHES;
+    glNamedBufferData(patchBuffer, sizeof(glm::vec4) * clipmapLevels * tilesPerSide * tilesPerSide, nullptr, GL_DYNAMIC_DRAW);
+    glNamedBufferData(drawCommand, 5 * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
 }
@@ -0,0 +1,152 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <oceanHeightField.h>
+#include <threadPool.h>
+
+// Floats many rigid bodies on an OceanHeightField. Each body is a handful of probe spheres in
+// body space; a probe pushes up with the weight of the water it displaces and drags against the
+// water where it is submerged, at its own position so uneven floating turns the body.
+// Everything is kept structure of arrays: Step transforms all probes, samples their water heights
+// in one batch (OceanHeightField::SampleHeightSoA, AVX2 when available) and then integrates
+// the bodies, both halves split across a ThreadPool. Nothing in here touches OpenGL.
+class OceanBuoyancy
+{
+public:
+    explicit OceanBuoyancy(unsigned threadCount = 0) : pool(threadCount) {}
+
+    struct Probe {
+        glm::vec3 offset;   // body space
+        float radius;
+    };
+    // returns the body index; inertia is taken from a solid sphere of boundingRadius
+    int AddBody(const glm::vec3& position, float mass, float boundingRadius, const std::vector<Probe>& probes) {
+        int body = BodyCount();
+        px.push_back(position.x); py.push_back(position.y); pz.push_back(position.z);
+        vx.push_back(0); vy.push_back(0); vz.push_back(0);
+        wx.push_back(0); wy.push_back(0); wz.push_back(0);
+        orientation.push_back(glm::quat(1, 0, 0, 0));
+        inverseMass.push_back(1.0f / mass);
+        inverseInertia.push_back(1.0f / (0.4f * mass * boundingRadius * boundingRadius));
+        probeStart.push_back((int)probeRadius.size());
+        probeCount.push_back((int)probes.size());
+        for (const Probe& probe : probes) {
+            ox.push_back(probe.offset.x); oy.push_back(probe.offset.y); oz.push_back(probe.offset.z);
+            probeRadius.push_back(probe.radius);
+        }
+        size_t probeTotal = probeRadius.size();
+        worldX.resize(probeTotal); worldY.resize(probeTotal); worldZ.resize(probeTotal);
+        waterHeight.resize(probeTotal);
+        return body;
+    }
+    void Clear() {
+        for (std::vector<float>* v : { &px, &py, &pz, &vx, &vy, &vz, &wx, &wy, &wz, &inverseMass, &inverseInertia,
+                                       &ox, &oy, &oz, &probeRadius, &worldX, &worldY, &worldZ, &waterHeight })
+            v->clear();
+        orientation.clear();
+        probeStart.clear();
+        probeCount.clear();
+    }
+
+    int BodyCount() const { return (int)px.size(); }
+    int ProbeCount() const { return (int)probeRadius.size(); }
+    glm::vec3 Position(int body) const { return glm::vec3(px[body], py[body], pz[body]); }
+    glm::quat Orientation(int body) const { return orientation[body]; }
+    glm::vec3 Velocity(int body) const { return glm::vec3(vx[body], vy[body], vz[body]); }
+
+    float gravity = 9.81f;
+    float waterDensity = 1025.0f;
+    float linearDrag = 1.0f;     // per second, on the displaced water mass of each probe
+    float angularDrag = 0.8f;
+
+    void Step(const OceanHeightField& field, float dt) {
+        if (BodyCount() == 0 || dt <= 0)
+            return;
+        // probes: body space -> world, then one batched height lookup per block
+        pool.parallelFor((ProbeCount() + PROBE_BLOCK - 1) / PROBE_BLOCK, [&](int block) {
+            int begin = block * PROBE_BLOCK;
+            int end = std::min(begin + PROBE_BLOCK, ProbeCount());
+            TransformProbes(begin, end);
+            field.SampleHeightSoA(worldX.data() + begin, worldZ.data() + begin, waterHeight.data() + begin, end - begin);
+        });
+        // bodies: sum their probes' forces and integrate
+        pool.parallelFor((BodyCount() + BODY_BLOCK - 1) / BODY_BLOCK, [&](int block) {
+            int begin = block * BODY_BLOCK;
+            int end = std::min(begin + BODY_BLOCK, BodyCount());
+            for (int body = begin; body < end; ++body)
+                Integrate(body, dt);
+        });
+    }
+
+private:
+    static const int PROBE_BLOCK = 1024;
+    static const int BODY_BLOCK = 256;
+
+    void TransformProbes(int begin, int end) {
+        // probes are stored body by body, so walk bodies and reuse each rotation
+        int body = int(std::upper_bound(probeStart.begin(), probeStart.end(), begin) - probeStart.begin()) - 1;
+        for (int p = begin; p < end; ++body) {
+            glm::mat3 rotation = glm::mat3_cast(orientation[body]);
+            int last = std::min(probeStart[body] + probeCount[body], end);
+            for (; p < last; ++p) {
+                glm::vec3 world = rotation * glm::vec3(ox[p], oy[p], oz[p]);
+                worldX[p] = px[body] + world.x;
+                worldY[p] = py[body] + world.y;
+                worldZ[p] = pz[body] + world.z;
+            }
+        }
+    }
+
+    void Integrate(int body, float dt) {
+        glm::vec3 position(px[body], py[body], pz[body]);
+        glm::vec3 velocity(vx[body], vy[body], vz[body]);
+        glm::vec3 spin(wx[body], wy[body], wz[body]);
+        glm::vec3 force(0.0f, -gravity / inverseMass[body], 0.0f);
+        glm::vec3 torque(0.0f);
+        float submerged = 0.0f;
+
+        for (int p = probeStart[body]; p < probeStart[body] + probeCount[body]; ++p) {
+            float r = probeRadius[p];
+            // depth of the sphere's bottom below the surface, as a fraction of its diameter
+            float depth = glm::clamp((waterHeight[p] - (worldY[p] - r)) / (2.0f * r), 0.0f, 1.0f);
+            if (depth == 0.0f)
+                continue;
+            // cap volume approximated linearly in the depth fraction
+            float volume = 4.18879f * r * r * r * depth;
+            glm::vec3 arm = glm::vec3(worldX[p], worldY[p], worldZ[p]) - position;
+            glm::vec3 pointVelocity = velocity + glm::cross(spin, arm);
+            // drag follows the displaced water mass, so it also damps rolling through the arm
+            glm::vec3 probeForce = glm::vec3(0.0f, waterDensity * gravity * volume, 0.0f)
+                - pointVelocity * (linearDrag * waterDensity * volume);
+            force += probeForce;
+            torque += glm::cross(arm, probeForce);
+            submerged += depth;
+        }
+        submerged /= std::max(probeCount[body], 1);
+
+        // semi-implicit Euler
+        velocity += force * inverseMass[body] * dt;
+        spin += torque * inverseInertia[body] * dt;
+        spin *= 1.0f / (1.0f + angularDrag * submerged * dt);
+        position += velocity * dt;
+        glm::quat q = orientation[body];
+        q = glm::normalize(q + glm::quat(0.0f, spin * (0.5f * dt)) * q);
+
+        px[body] = position.x; py[body] = position.y; pz[body] = position.z;
+        vx[body] = velocity.x; vy[body] = velocity.y; vz[body] = velocity.z;
+        wx[body] = spin.x; wy[body] = spin.y; wz[body] = spin.z;
+        orientation[body] = q;
+    }
+
+    ThreadPool pool;
+    // bodies
+    std::vector<float> px, py, pz, vx, vy, vz, wx, wy, wz;
+    std::vector<glm::quat> orientation;
+    std::vector<float> inverseMass, inverseInertia;
+    std::vector<int> probeStart, probeCount;
+    // probes, body space offsets and the world positions/water heights of the current step
+    std::vector<float> ox, oy, oz, probeRadius;
+    std::vector<float> worldX, worldY, worldZ, waterHeight;
+};
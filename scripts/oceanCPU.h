@@ -0,0 +1,518 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <glm/glm.hpp>
+#include <oceanParameters.h>
+#include <threadPool.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// CPU mirror of the OceanFFTGenerator pipeline for machines without a GPU.
+// Every stage follows its compute shader line for line:
+//   CalculateSpectrum  -> Spectrum_INIT.cps + SpectrumConjugate.cps
+//   EvolveSpectrum     -> time_evolution.cps
+//   IFFT               -> horizontalFFT.cps / verticalFFT.cps
+//   AssembleTextures   -> fftNormalize.cps
+// Results are kept in FP32, so they match the GPU textures to half float precision. Every cascade
+// is sized like its GPU arrays (LayerTextureSize), so the layers can differ in size.
+// The FFT butterflies use AVX2 when the compiler targets it, and all stages are split across a ThreadPool.
+class OceanCPUGenerator
+{
+public:
+    OceanCPUGenerator(unsigned threadCount = 0);
+
+    void InitialBake(const perChangeParameters& parameters);
+    void CalculateSpectrum();
+    void EvolveSpectrum(float time);
+    void IFFT();
+    void AssembleTextures();
+    // Evolve + IFFT + Assemble, what the main loop runs every frame
+    void Update(float time);
+
+    int TextureCount() const { return (int)DomainSizes.size(); }
+    int Size(int layer) const { return layout[layer].size; }
+    // Size(layer)^2 texels per layer, row major like the GPU texture layers
+    const glm::vec4* InitialSpectrum(int layer) const { return initialSpectrum.data() + layout[layer].offset; }
+    const glm::vec4* Displacement(int layer) const { return displacement.data() + layout[layer].offset; }
+    const glm::vec2* Slope(int layer) const { return slope.data() + layout[layer].offset; }
+
+    perFrameParameters frame;
+
+private:
+    // four complex signals per cascade, matching the rg/ba halves of the two spectrum layers
+    static const int SignalsPerCascade = 4;
+    // rows or columns transformed together by one FFTPass task
+    static const int LineBlock = 16;
+
+    // signal of a cascade, size^2 values
+    float* PlaneRe(int cascade, int signal) { return re.data() + PlaneOffset(cascade, signal); }
+    float* PlaneIm(int cascade, int signal) { return im.data() + PlaneOffset(cascade, signal); }
+    size_t PlaneOffset(int cascade, int signal) const {
+        const CascadeLayout& cascadeLayout = layout[cascade];
+        return cascadeLayout.offset * SignalsPerCascade + (size_t)signal * cascadeLayout.size * cascadeLayout.size;
+    }
+    void FFTPass(bool horizontal);
+    void PrecomputeTwiddles(int N);
+
+    ThreadPool pool;
+    // where a cascade's texels start in the per-texel arrays, the planes start SignalsPerCascade times as far
+    struct CascadeLayout {
+        int size;
+        int logN;
+        size_t offset;
+    };
+    std::vector<CascadeLayout> layout;
+    int maxSize = 0;               // of the cascades, sizes the task grids
+    std::vector<int> DomainSizes;
+    std::vector<SpectrumSettings> spectrums;
+
+    std::vector<glm::vec4> initialSpectrum;
+    std::vector<float> re, im;                 // spectrum planes, transformed in place
+    std::vector<glm::vec4> displacement;       // xyz displacement, w foam
+    std::vector<glm::vec2> slope;
+
+    // per FFT step and output index: the two inputs and the conjugated twiddle (precomputeDiddyFactor.cps)
+    struct Butterfly {
+        int a, b;
+        float wr, wi;
+    };
+    std::map<int, std::vector<Butterfly>> twiddles;   // by FFT size
+
+    //parameters
+    float gravity = 9.81f;
+    float lowCutOff = 0.001f;
+    float highCutOff = 9000;
+    float Depth = 20;
+    int seed = 1;
+};
+
+namespace oceanCPU {
+
+    const float PI = 3.14159265359f;
+
+    // Same integer hash as Spectrum_INIT.cps, unsigned wrap-around included
+    inline float hash(uint32_t n) {
+        n = (n << 13U) ^ n;
+        const uint32_t HIGH_PART = 0x1376U;
+        const uint32_t LOW_PART = 0x312589U;
+        n = n * (n * n * 15731U + 0x789221U);
+        n = n + LOW_PART;
+        n = n + (HIGH_PART << 24U);
+        return float(n & 0x7FFFFFFFU) / float(0x7FFFFFFF);
+    }
+
+    inline float Dispersion(float kMag, float gravity, float depth) {
+        return std::sqrt(gravity * kMag * std::tanh(glm::min(kMag * depth, 20.0f)));
+    }
+    inline float DispersionDerivative(float kMag, float gravity, float depth) {
+        float th = std::tanh(glm::min(kMag * depth, 20.0f));
+        float ch = std::cosh(kMag * depth);
+        return gravity * (depth * kMag / ch / ch + th) / Dispersion(kMag, gravity, depth) / 2.0f;
+    }
+    inline float TMACorrection(float omega, float gravity, float depth) {
+        float omegaH = omega * std::sqrt(depth / gravity);
+        if (omegaH <= 1.0f)
+            return 0.5f * omegaH * omegaH;
+        if (omegaH < 2.0f)
+            return 1.0f - 0.5f * (2.0f - omegaH) * (2.0f - omegaH);
+        return 1.0f;
+    }
+    inline float SpreadPower(float omega, float peakOmega) {
+        if (omega > peakOmega)
+            return 9.77f * std::pow(std::abs(omega / peakOmega), -2.5f);
+        else
+            return 6.97f * std::pow(std::abs(omega / peakOmega), 5.0f);
+    }
+    inline glm::vec2 UniformToGaussian(float u1, float u2) {
+        float R = std::sqrt(-2.0f * std::log(u1));
+        float theta = 2.0f * PI * u2;
+        return glm::vec2(R * std::cos(theta), R * std::sin(theta));
+    }
+    inline float JONSWAP(float omega, const SpectrumSettings& spectrum, float gravity, float depth) {
+        float sigma = (omega <= spectrum.peakOmega) ? 0.07f : 0.09f;
+        float r = std::exp(-(omega - spectrum.peakOmega) * (omega - spectrum.peakOmega) / 2.0f / sigma / sigma / spectrum.peakOmega / spectrum.peakOmega);
+        float oneOverOmega = 1.0f / omega;
+        float peakOmegaOverOmega = spectrum.peakOmega / omega;
+        return spectrum.scale * TMACorrection(omega, gravity, depth) * spectrum.alpha * gravity * gravity
+            * oneOverOmega * oneOverOmega * oneOverOmega * oneOverOmega * oneOverOmega
+            * std::exp(-1.25f * peakOmegaOverOmega * peakOmegaOverOmega * peakOmegaOverOmega * peakOmegaOverOmega)
+            * std::pow(std::abs(spectrum.gamma), r);
+    }
+    inline float NormalizationFactor(float s) {
+        float s2 = s * s;
+        float s3 = s2 * s;
+        float s4 = s3 * s;
+        if (s < 5) return -0.000564f * s4 + 0.00776f * s3 - 0.044f * s2 + 0.192f * s + 0.163f;
+        else return -4.80e-08f * s4 + 1.07e-05f * s3 - 9.53e-04f * s2 + 5.90e-02f * s + 3.93e-01f;
+    }
+    inline float Cosine2s(float theta, float s) {
+        return NormalizationFactor(s) * std::pow(std::abs(std::cos(0.5f * theta)), 2.0f * s);
+    }
+    inline float ShortWavesFade(float kLength, const SpectrumSettings& spectrum) {
+        return std::exp(-spectrum.shortWavesFade * spectrum.shortWavesFade * kLength * kLength);
+    }
+    inline float DirectionSpectrum(float theta, float omega, const SpectrumSettings& spectrum) {
+        float s = SpreadPower(omega, spectrum.peakOmega) + 16 * std::tanh(glm::min(omega / spectrum.peakOmega, 20.0f)) * spectrum.swell * spectrum.swell;
+        return glm::mix(2.0f / 3.1415f * std::cos(theta) * std::cos(theta), Cosine2s(theta - spectrum.angle, s), spectrum.spreadBlend);
+    }
+    inline glm::vec2 ComplexMult(glm::vec2 a, glm::vec2 b) {
+        return glm::vec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+    }
+
+    // out = a + w * b over count lanes of split real/imaginary data
+    inline void ButterflyRow(const float* aRe, const float* aIm, const float* bRe, const float* bIm,
+        float* outRe, float* outIm, int count, float wr, float wi) {
+        int x = 0;
+#if defined(__AVX2__)
+        __m256 vwr = _mm256_set1_ps(wr);
+        __m256 vwi = _mm256_set1_ps(wi);
+        for (; x + 8 <= count; x += 8) {
+            __m256 br = _mm256_loadu_ps(bRe + x);
+            __m256 bi = _mm256_loadu_ps(bIm + x);
+            __m256 tr = _mm256_sub_ps(_mm256_mul_ps(vwr, br), _mm256_mul_ps(vwi, bi));
+            __m256 ti = _mm256_add_ps(_mm256_mul_ps(vwr, bi), _mm256_mul_ps(vwi, br));
+            _mm256_storeu_ps(outRe + x, _mm256_add_ps(_mm256_loadu_ps(aRe + x), tr));
+            _mm256_storeu_ps(outIm + x, _mm256_add_ps(_mm256_loadu_ps(aIm + x), ti));
+        }
+#endif
+        for (; x < count; ++x) {
+            float tr = wr * bRe[x] - wi * bIm[x];
+            float ti = wr * bIm[x] + wi * bRe[x];
+            outRe[x] = aRe[x] + tr;
+            outIm[x] = aIm[x] + ti;
+        }
+    }
+}
+
+OceanCPUGenerator::OceanCPUGenerator(unsigned threadCount) : pool(threadCount) {}
+
+void OceanCPUGenerator::InitialBake(const perChangeParameters& parameters) {
+    int amount = parameters.TextureCount;
+
+    Depth = parameters.Depth;
+    gravity = parameters.Gravity;
+    highCutOff = parameters.highCutOff;
+    lowCutOff = parameters.lowCutOff;
+    seed = parameters.seed;
+
+    DomainSizes.clear();
+    layout.clear();
+    spectrums.resize(amount * 2);
+    size_t texels = 0;
+    maxSize = 0;
+    for (int i = 0; i < amount; ++i) {
+        DomainSizes.push_back(parameters.layers[i].DomainSize);
+        FillSpectrumStruct(parameters.layers[i].spec1, spectrums[i * 2], gravity);
+        FillSpectrumStruct(parameters.layers[i].spec2, spectrums[i * 2 + 1], gravity);
+
+        // the size AllocateCascade gives the GPU arrays
+        int size = LayerTextureSize(parameters, i);
+        layout.push_back({ size, (int)std::round(std::log2((double)size)), texels });
+        texels += (size_t)size * size;
+        maxSize = glm::max(maxSize, size);
+        if (twiddles.find(size) == twiddles.end())
+            PrecomputeTwiddles(size);
+    }
+
+    initialSpectrum.assign(texels, glm::vec4(0.0f));
+    re.assign(texels * SignalsPerCascade, 0.0f);
+    im.assign(texels * SignalsPerCascade, 0.0f);
+    displacement.assign(texels, glm::vec4(0.0f));
+    slope.assign(texels, glm::vec2(0.0f));
+}
+
+void OceanCPUGenerator::PrecomputeTwiddles(int N) {
+    int logN = (int)std::round(std::log2((double)N));
+    std::vector<Butterfly>& table = twiddles[N];
+    table.resize((size_t)logN * N);
+    for (int step = 0; step < logN; ++step) {
+        for (int j = 0; j < N / 2; ++j) {
+            int b = N >> (step + 1);
+            int i = (2 * b * (j / b) + j % b) % N;
+            double angle = -2.0 * 3.14159265358979323846 * ((j / b) * b) / N;
+            // the FFT shaders multiply by conj(twiddle)
+            float wr = (float)std::cos(angle);
+            float wi = (float)-std::sin(angle);
+            table[(size_t)step * N + j] = { i, i + b, wr, wi };
+            table[(size_t)step * N + j + N / 2] = { i, i + b, -wr, -wi };
+        }
+    }
+}
+
+void OceanCPUGenerator::CalculateSpectrum() {
+    const int rowsPerTask = 16;
+    // as many tasks per cascade as the largest one needs, the smaller ones skip the rest
+    int rowTasks = (maxSize + rowsPerTask - 1) / rowsPerTask;
+    int cascades = TextureCount();
+
+    // Spectrum_INIT.cps
+    pool.parallelFor(cascades * rowTasks, [&](int task) {
+        uint32_t i = (uint32_t)(task / rowTasks);
+        int N = layout[i].size;
+        int y0 = (task % rowTasks) * rowsPerTask;
+        int y1 = glm::min(y0 + rowsPerTask, N);
+        uint32_t _N = (uint32_t)N;
+        float halfN = _N / 2.0f;
+        float lengthScales = (float)DomainSizes[i];
+        float deltaK = 2.0f * oceanCPU::PI / lengthScales;
+        const SpectrumSettings& spectrum1 = spectrums[i * 2];
+        const SpectrumSettings& spectrum2 = spectrums[i * 2 + 1];
+        glm::vec4* layer = initialSpectrum.data() + layout[i].offset;
+
+        for (int y = y0; y < y1; ++y) {
+            for (int x = 0; x < N; ++x) {
+                uint32_t pixelSeed = (uint32_t)x + _N * (uint32_t)y + _N;
+                pixelSeed += (uint32_t)seed;
+
+                glm::vec2 K = (glm::vec2((float)x, (float)y) - halfN) * deltaK;
+                float kLength = glm::length(K);
+
+                pixelSeed += (uint32_t)(int)((float)i + oceanCPU::hash(pixelSeed) * 10);
+                glm::vec4 uniformRandSamples(oceanCPU::hash(pixelSeed), oceanCPU::hash(pixelSeed * 2),
+                    oceanCPU::hash(pixelSeed * 3), oceanCPU::hash(pixelSeed * 4));
+                glm::vec2 gauss1 = oceanCPU::UniformToGaussian(uniformRandSamples.x, uniformRandSamples.y);
+                glm::vec2 gauss2 = oceanCPU::UniformToGaussian(uniformRandSamples.z, uniformRandSamples.w);
+
+                glm::vec4 result(0.0f);
+                if (lowCutOff <= kLength && kLength <= highCutOff) {
+                    float kAngle = std::atan2(K.y, K.x);
+                    float omega = oceanCPU::Dispersion(kLength, gravity, Depth);
+                    float dOmegadk = oceanCPU::DispersionDerivative(kLength, gravity, Depth);
+
+                    float spectrum = oceanCPU::JONSWAP(omega, spectrum1, gravity, Depth) * oceanCPU::DirectionSpectrum(kAngle, omega, spectrum1) * oceanCPU::ShortWavesFade(kLength, spectrum1);
+                    if (spectrum2.scale > 0)
+                        spectrum += oceanCPU::JONSWAP(omega, spectrum2, gravity, Depth) * oceanCPU::DirectionSpectrum(kAngle, omega, spectrum2) * oceanCPU::ShortWavesFade(kLength, spectrum2);
+
+                    result = glm::vec4(glm::vec2(gauss2.x, gauss1.y) * std::sqrt(2 * spectrum * std::abs(dOmegadk) / kLength * deltaK * deltaK), 0.0f, 0.0f);
+                }
+                layer[(size_t)y * N + x] = result;
+            }
+        }
+        });
+
+    // SpectrumConjugate.cps, only zw are written so reading xy in place is safe
+    pool.parallelFor(cascades * rowTasks, [&](int task) {
+        int i = task / rowTasks;
+        int N = layout[i].size;
+        int y0 = (task % rowTasks) * rowsPerTask;
+        int y1 = glm::min(y0 + rowsPerTask, N);
+        glm::vec4* layer = initialSpectrum.data() + layout[i].offset;
+        for (int y = y0; y < y1; ++y) {
+            for (int x = 0; x < N; ++x) {
+                glm::vec4& h0 = layer[(size_t)y * N + x];
+                const glm::vec4& conj = layer[(size_t)((N - y) % N) * N + (N - x) % N];
+                h0.z = conj.x;
+                h0.w = -conj.y;
+            }
+        }
+        });
+}
+
+void OceanCPUGenerator::EvolveSpectrum(float time) {
+    const int rowsPerTask = 16;
+    int rowTasks = (maxSize + rowsPerTask - 1) / rowsPerTask;
+
+    // time_evolution.cps
+    pool.parallelFor(TextureCount() * rowTasks, [&](int task) {
+        int i = task / rowTasks;
+        int N = layout[i].size;
+        int y0 = (task % rowTasks) * rowsPerTask;
+        int y1 = glm::min(y0 + rowsPerTask, N);
+        const glm::vec4* h0Layer = InitialSpectrum(i);
+        float* dispXRe = PlaneRe(i, 0);
+        float* dispXIm = PlaneIm(i, 0);
+        float* dispZRe = PlaneRe(i, 1);
+        float* dispZIm = PlaneIm(i, 1);
+        float* slopeXRe = PlaneRe(i, 2);
+        float* slopeXIm = PlaneIm(i, 2);
+        float* slopeZRe = PlaneRe(i, 3);
+        float* slopeZIm = PlaneIm(i, 3);
+        float halfN = N / 2.0f;
+        float w_0 = 2.0f * oceanCPU::PI / frame.repeatTime;
+
+        for (int y = y0; y < y1; ++y) {
+            for (int x = 0; x < N; ++x) {
+                size_t index = (size_t)y * N + x;
+                glm::vec4 initial_signal = h0Layer[index];
+                glm::vec2 h0(initial_signal.x, initial_signal.y);
+                glm::vec2 h0_conj(initial_signal.z, initial_signal.w);
+
+                glm::vec2 K = (glm::vec2((float)x, (float)y) - halfN) * 2.0f * oceanCPU::PI / (float)DomainSizes[i];
+                float kMag = glm::length(K);
+                float kMagRcp = 1 / kMag;
+                if (kMag < 0.0001f)
+                    kMagRcp = 1.0f;
+
+                float dispersion = std::floor(std::sqrt(gravity * kMag) / w_0) * w_0 * time;
+                glm::vec2 exponent(std::cos(dispersion), std::sin(dispersion));
+                glm::vec2 htilde = oceanCPU::ComplexMult(h0, exponent) + oceanCPU::ComplexMult(h0_conj, glm::vec2(exponent.x, -exponent.y));
+                glm::vec2 ih(-htilde.y, htilde.x);
+
+                glm::vec2 displacementX = ih * K.x * kMagRcp;
+                glm::vec2 displacementY = htilde;
+                glm::vec2 displacementZ = ih * K.y * kMagRcp;
+
+                glm::vec2 displacementX_dx = -htilde * K.x * K.x * kMagRcp;
+                glm::vec2 displacementY_dx = ih * K.x;
+                glm::vec2 displacementZ_dx = -htilde * K.x * K.y * kMagRcp;
+
+                glm::vec2 displacementY_dz = ih * K.y;
+                glm::vec2 displacementZ_dz = -htilde * K.y * K.y * kMagRcp;
+
+                dispXRe[index] = displacementX.x - displacementZ.y;
+                dispXIm[index] = displacementX.y + displacementZ.x;
+                dispZRe[index] = displacementY.x - displacementZ_dx.y;
+                dispZIm[index] = displacementY.y + displacementZ_dx.x;
+                slopeXRe[index] = displacementY_dx.x - displacementY_dz.y;
+                slopeXIm[index] = displacementY_dx.y + displacementY_dz.x;
+                slopeZRe[index] = displacementX_dx.x - displacementZ_dz.y;
+                slopeZIm[index] = displacementX_dx.y + displacementZ_dz.x;
+            }
+        }
+        });
+}
+
+// Runs every FFT step along one axis of each plane. A narrow block of lines is gathered into
+// contiguous scratch (transposed on the way in for rows) so the log2(N) steps stay in cache,
+// and each butterfly is a SIMD add across the block with one broadcast twiddle.
+void OceanCPUGenerator::FFTPass(bool horizontal) {
+    int planes = TextureCount() * SignalsPerCascade;
+    // as many tasks per plane as the largest cascade needs, the smaller ones skip the rest
+    int blocks = maxSize / glm::min(maxSize, LineBlock);
+
+    pool.parallelFor(planes * blocks, [&](int task) {
+        int plane = task / blocks;
+        int cascade = plane / SignalsPerCascade;
+        int N = layout[cascade].size;
+        int logN = layout[cascade].logN;
+        const int blockWidth = glm::min(N, LineBlock);
+        int line0 = (task % blocks) * blockWidth;
+        if (line0 >= N)
+            return;
+        float* planeRe = PlaneRe(cascade, plane % SignalsPerCascade);
+        float* planeIm = PlaneIm(cascade, plane % SignalsPerCascade);
+        const std::vector<Butterfly>& butterflies = twiddles.at(N);
+
+        // four N x blockWidth buffers: src re/im and dst re/im
+        thread_local std::vector<float> block;
+        block.resize((size_t)4 * N * blockWidth);
+        float* srcRe = block.data();
+        float* srcIm = srcRe + (size_t)N * blockWidth;
+        float* dstRe = srcIm + (size_t)N * blockWidth;
+        float* dstIm = dstRe + (size_t)N * blockWidth;
+
+        // src[k * blockWidth + l] is element k of line line0 + l
+        if (horizontal) {
+            for (int l = 0; l < blockWidth; ++l) {
+                const float* rowRe = planeRe + (size_t)(line0 + l) * N;
+                const float* rowIm = planeIm + (size_t)(line0 + l) * N;
+                for (int k = 0; k < N; ++k) {
+                    srcRe[(size_t)k * blockWidth + l] = rowRe[k];
+                    srcIm[(size_t)k * blockWidth + l] = rowIm[k];
+                }
+            }
+        }
+        else {
+            for (int k = 0; k < N; ++k) {
+                std::copy(planeRe + (size_t)k * N + line0, planeRe + (size_t)k * N + line0 + blockWidth, srcRe + (size_t)k * blockWidth);
+                std::copy(planeIm + (size_t)k * N + line0, planeIm + (size_t)k * N + line0 + blockWidth, srcIm + (size_t)k * blockWidth);
+            }
+        }
+
+        for (int step = 0; step < logN; ++step) {
+            const Butterfly* table = butterflies.data() + (size_t)step * N;
+            for (int j = 0; j < N; ++j) {
+                const Butterfly& data = table[j];
+                oceanCPU::ButterflyRow(srcRe + (size_t)data.a * blockWidth, srcIm + (size_t)data.a * blockWidth,
+                    srcRe + (size_t)data.b * blockWidth, srcIm + (size_t)data.b * blockWidth,
+                    dstRe + (size_t)j * blockWidth, dstIm + (size_t)j * blockWidth, blockWidth, data.wr, data.wi);
+            }
+            std::swap(srcRe, dstRe);
+            std::swap(srcIm, dstIm);
+        }
+
+        if (horizontal) {
+            for (int l = 0; l < blockWidth; ++l) {
+                float* rowRe = planeRe + (size_t)(line0 + l) * N;
+                float* rowIm = planeIm + (size_t)(line0 + l) * N;
+                for (int k = 0; k < N; ++k) {
+                    rowRe[k] = srcRe[(size_t)k * blockWidth + l];
+                    rowIm[k] = srcIm[(size_t)k * blockWidth + l];
+                }
+            }
+        }
+        else {
+            for (int k = 0; k < N; ++k) {
+                std::copy(srcRe + (size_t)k * blockWidth, srcRe + (size_t)(k + 1) * blockWidth, planeRe + (size_t)k * N + line0);
+                std::copy(srcIm + (size_t)k * blockWidth, srcIm + (size_t)(k + 1) * blockWidth, planeIm + (size_t)k * N + line0);
+            }
+        }
+        });
+}
+
+// horizontalFFT.cps then verticalFFT.cps
+void OceanCPUGenerator::IFFT() {
+    FFTPass(true);
+    FFTPass(false);
+}
+
+void OceanCPUGenerator::AssembleTextures() {
+    const int rowsPerTask = 16;
+    int rowTasks = (maxSize + rowsPerTask - 1) / rowsPerTask;
+
+    // fftNormalize.cps
+    pool.parallelFor(TextureCount() * rowTasks, [&](int task) {
+        int i = task / rowTasks;
+        int N = layout[i].size;
+        int y0 = (task % rowTasks) * rowsPerTask;
+        int y1 = glm::min(y0 + rowsPerTask, N);
+        const float* dispXRe = PlaneRe(i, 0);
+        const float* dispXIm = PlaneIm(i, 0);
+        const float* dispZRe = PlaneRe(i, 1);
+        const float* dispZIm = PlaneIm(i, 1);
+        const float* slopeXRe = PlaneRe(i, 2);
+        const float* slopeXIm = PlaneIm(i, 2);
+        const float* slopeZRe = PlaneRe(i, 3);
+        const float* slopeZIm = PlaneIm(i, 3);
+        glm::vec4* displacementLayer = displacement.data() + layout[i].offset;
+        glm::vec2* slopeLayer = slope.data() + layout[i].offset;
+        glm::vec2 _Lambda = frame.lambda;
+
+        for (int y = y0; y < y1; ++y) {
+            for (int x = 0; x < N; ++x) {
+                size_t index = (size_t)y * N + x;
+                // Permute
+                float sign = 1.0f - 2.0f * ((x + y) % 2);
+                glm::vec2 dxdz(dispXRe[index] * sign, dispXIm[index] * sign);
+                glm::vec2 dydxz(dispZRe[index] * sign, dispZIm[index] * sign);
+                glm::vec2 dyxdyz(slopeXRe[index] * sign, slopeXIm[index] * sign);
+                glm::vec2 dxxdzz(slopeZRe[index] * sign, slopeZIm[index] * sign);
+
+                float jacobian = (1.0f + _Lambda.x * dxxdzz.x) * (1.0f + _Lambda.y * dxxdzz.y) - _Lambda.x * _Lambda.y * dydxz.y * dydxz.y;
+                glm::vec3 displacementValue(_Lambda.x * dxdz.x, dydxz.x, _Lambda.y * dxdz.y);
+                glm::vec2 slopes = dyxdyz / (1.0f + glm::abs(dxxdzz * _Lambda));
+
+                float foam = displacementLayer[index].w;
+                foam *= std::exp(-frame.foamDecayRate);
+                foam = glm::clamp(foam, 0.0f, 1.0f);
+
+                float biasedJacobian = glm::max(0.0f, -(jacobian - frame.foamBias));
+                if (biasedJacobian > frame.foamThreshold)
+                    foam += frame.foamAdd * biasedJacobian;
+
+                displacementLayer[index] = glm::vec4(displacementValue, foam);
+                slopeLayer[index] = slopes;
+            }
+        }
+        });
+}
+
+void OceanCPUGenerator::Update(float time) {
+    EvolveSpectrum(time);
+    IFFT();
+    AssembleTextures();
+}
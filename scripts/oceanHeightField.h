@@ -0,0 +1,156 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// CPU copy of the ocean surface for gameplay queries. Holds every cascade's displacement (xyz)
+// and foam (w), box filtered down to resolution x resolution, as OceanFFTGenerator last read it back.
+// Cascade c repeats every tileSizes[c] world units, the way the render shaders sample it.
+// Nothing in here touches OpenGL. SampleHeightSoA runs eight points at a time with AVX2 when the
+// compiler targets it.
+
+class OceanHeightField
+{
+public:
+    // fixed point steps that undo the horizontal displacement, each roughly halves the error
+    static const int INVERSION_STEPS = 4;
+
+    void Resize(int resolution, const std::vector<float>& tileSizes) {
+        this->resolution = resolution;
+        this->tileSizes = tileSizes;
+        texels.assign((size_t)resolution * resolution * tileSizes.size(), glm::vec4(0.0f));
+        time = -1.0f;
+    }
+    int Resolution() const { return resolution; }
+    int CascadeCount() const { return (int)tileSizes.size(); }
+    const std::vector<float>& TileSizes() const { return tileSizes; }
+    // cascade-major, row-major texels, written by OceanFFTGenerator
+    std::vector<glm::vec4>& Texels() { return texels; }
+    // simulation time of the copy, negative until the first readback arrived
+    float time = -1.0f;
+    bool Ready() const { return time >= 0.0f; }
+
+    // summed displacement and foam of the water that started at the undisplaced point position
+    glm::vec4 DisplacementAt(glm::vec2 position) const {
+        glm::vec4 sum(0.0f);
+        for (int c = 0; c < CascadeCount(); ++c)
+            sum += Bilinear(c, position / tileSizes[c]);
+        return sum;
+    }
+
+    // displacement of the surface point that ends up above each (x, z) position, that is
+    // DisplacementAt(p0) for the p0 with p0 + displacement.xz == position
+    void SampleDisplacement(const glm::vec2* positions, glm::vec3* displacements, int count) const {
+        for (int i = 0; i < count; ++i)
+            displacements[i] = glm::vec3(Invert(positions[i]));
+    }
+    // water height above each (x, z) position
+    void SampleHeight(const glm::vec2* positions, float* heights, int count) const {
+        for (int i = 0; i < count; ++i)
+            heights[i] = Invert(positions[i]).y;
+    }
+    // SampleHeight over separate x and z arrays, the layout batched callers keep their points in
+    void SampleHeightSoA(const float* xs, const float* zs, float* heights, int count) const {
+        int i = 0;
+#if defined(__AVX2__)
+        for (; i + 8 <= count; i += 8)
+            Invert8(xs + i, zs + i, heights + i);
+#endif
+        for (; i < count; ++i)
+            heights[i] = Invert(glm::vec2(xs[i], zs[i])).y;
+    }
+
+private:
+    glm::vec4 Invert(glm::vec2 position) const {
+        glm::vec2 origin = position;
+        glm::vec4 displacement = DisplacementAt(origin);
+        for (int step = 0; step < INVERSION_STEPS; ++step) {
+            origin = position - glm::vec2(displacement.x, displacement.z);
+            displacement = DisplacementAt(origin);
+        }
+        return displacement;
+    }
+    // GL_REPEAT + GL_LINEAR lookup of one cascade at uv
+    glm::vec4 Bilinear(int cascade, glm::vec2 uv) const {
+        glm::vec2 texel = uv * float(resolution) - 0.5f;
+        glm::vec2 base = glm::floor(texel);
+        glm::vec2 f = texel - base;
+        int x0 = Wrap((int)base.x), y0 = Wrap((int)base.y);
+        int x1 = Wrap(x0 + 1), y1 = Wrap(y0 + 1);
+        const glm::vec4* layer = texels.data() + (size_t)cascade * resolution * resolution;
+        glm::vec4 bottom = glm::mix(layer[y0 * resolution + x0], layer[y0 * resolution + x1], f.x);
+        glm::vec4 top = glm::mix(layer[y1 * resolution + x0], layer[y1 * resolution + x1], f.x);
+        return glm::mix(bottom, top, f.y);
+    }
+#if defined(__AVX2__)
+    // Invert for eight points: same fixed point steps, one bilinear lookup per cascade done with gathers
+    void Invert8(const float* xs, const float* zs, float* heights) const {
+        __m256 px = _mm256_loadu_ps(xs);
+        __m256 pz = _mm256_loadu_ps(zs);
+        __m256 dx, dy, dz;
+        Displacement8(px, pz, dx, dy, dz);
+        for (int step = 0; step < INVERSION_STEPS; ++step)
+            Displacement8(_mm256_sub_ps(px, dx), _mm256_sub_ps(pz, dz), dx, dy, dz);
+        _mm256_storeu_ps(heights, dy);
+    }
+    void Displacement8(__m256 x, __m256 z, __m256& dx, __m256& dy, __m256& dz) const {
+        const float* base = reinterpret_cast<const float*>(texels.data());
+        const __m256 res = _mm256_set1_ps(float(resolution));
+        const __m256 rcpRes = _mm256_set1_ps(1.0f / resolution);
+        const __m256i resI = _mm256_set1_epi32(resolution);
+        const __m256i one = _mm256_set1_epi32(1);
+        dx = dy = dz = _mm256_setzero_ps();
+        for (int c = 0; c < CascadeCount(); ++c) {
+            __m256 scale = _mm256_set1_ps(resolution / tileSizes[c]);
+            __m256 u = _mm256_sub_ps(_mm256_mul_ps(x, scale), _mm256_set1_ps(0.5f));
+            __m256 v = _mm256_sub_ps(_mm256_mul_ps(z, scale), _mm256_set1_ps(0.5f));
+            // wrap into [0, resolution) before splitting into texel and fraction
+            u = _mm256_sub_ps(u, _mm256_mul_ps(res, _mm256_floor_ps(_mm256_mul_ps(u, rcpRes))));
+            v = _mm256_sub_ps(v, _mm256_mul_ps(res, _mm256_floor_ps(_mm256_mul_ps(v, rcpRes))));
+            __m256 u0 = _mm256_floor_ps(u), v0 = _mm256_floor_ps(v);
+            __m256 fu = _mm256_sub_ps(u, u0), fv = _mm256_sub_ps(v, v0);
+            // float rounding can land exactly on resolution, min keeps the index inside
+            __m256i x0 = _mm256_min_epi32(_mm256_cvttps_epi32(u0), _mm256_sub_epi32(resI, one));
+            __m256i y0 = _mm256_min_epi32(_mm256_cvttps_epi32(v0), _mm256_sub_epi32(resI, one));
+            __m256i x1 = _mm256_add_epi32(x0, one);
+            __m256i y1 = _mm256_add_epi32(y0, one);
+            x1 = _mm256_andnot_si256(_mm256_cmpeq_epi32(x1, resI), x1);
+            y1 = _mm256_andnot_si256(_mm256_cmpeq_epi32(y1, resI), y1);
+
+            // float offsets of the four corners, four floats per texel
+            __m256i layer = _mm256_set1_epi32(c * resolution * resolution);
+            __m256i row0 = _mm256_add_epi32(layer, _mm256_mullo_epi32(y0, resI));
+            __m256i row1 = _mm256_add_epi32(layer, _mm256_mullo_epi32(y1, resI));
+            __m256i i00 = _mm256_slli_epi32(_mm256_add_epi32(row0, x0), 2);
+            __m256i i10 = _mm256_slli_epi32(_mm256_add_epi32(row0, x1), 2);
+            __m256i i01 = _mm256_slli_epi32(_mm256_add_epi32(row1, x0), 2);
+            __m256i i11 = _mm256_slli_epi32(_mm256_add_epi32(row1, x1), 2);
+
+            __m256 w00 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), fu), _mm256_sub_ps(_mm256_set1_ps(1.0f), fv));
+            __m256 w10 = _mm256_mul_ps(fu, _mm256_sub_ps(_mm256_set1_ps(1.0f), fv));
+            __m256 w01 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), fu), fv);
+            __m256 w11 = _mm256_mul_ps(fu, fv);
+            auto corners = [&](const float* component) {
+                __m256 sum = _mm256_mul_ps(w00, _mm256_i32gather_ps(component, i00, 4));
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(w10, _mm256_i32gather_ps(component, i10, 4)));
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(w01, _mm256_i32gather_ps(component, i01, 4)));
+                return _mm256_add_ps(sum, _mm256_mul_ps(w11, _mm256_i32gather_ps(component, i11, 4)));
+            };
+            dx = _mm256_add_ps(dx, corners(base));
+            dy = _mm256_add_ps(dy, corners(base + 1));
+            dz = _mm256_add_ps(dz, corners(base + 2));
+        }
+    }
+#endif
+    int Wrap(int i) const {
+        i %= resolution;
+        return i < 0 ? i + resolution : i;
+    }
+
+    int resolution = 0;
+    std::vector<float> tileSizes;
+    std::vector<glm::vec4> texels;
+};
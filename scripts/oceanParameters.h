@@ -0,0 +1,225 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+// Plain ocean parameter types shared by the GPU (ocean.h) and CPU (oceanCPU.h) pipelines.
+// Nothing in here touches OpenGL so headless builds can include it.
+
+struct DisplaySpectrumSettings {
+public:
+    //   [Range(0, 5)]
+    float scale;
+    float windSpeed;
+    //  [Range(0.0f, 360.0f)]
+    float windDirection;
+    float fetch;
+    //   [Range(0, 1)]
+    float spreadBlend;
+    //  [Range(0, 1)]
+    float swell;
+    float peakEnhancement;
+    float shortWavesFade;
+};
+// the render shaders declare their cascade sampler arrays with this many entries
+const int MAX_CASCADES = 4;
+const int MAX_UPDATE_INTERVAL = 8;
+
+struct Layer {
+public:
+    int DomainSize;
+    DisplaySpectrumSettings spec1;
+    DisplaySpectrumSettings spec2;
+    int TextureSize = 0;    // FFT size of this cascade, 0 uses perChangeParameters::TextureSize
+};
+inline bool operator==(const DisplaySpectrumSettings& a, const DisplaySpectrumSettings& b) {
+    return a.scale == b.scale && a.windSpeed == b.windSpeed && a.windDirection == b.windDirection && a.fetch == b.fetch
+        && a.spreadBlend == b.spreadBlend && a.swell == b.swell && a.peakEnhancement == b.peakEnhancement
+        && a.shortWavesFade == b.shortWavesFade;
+}
+inline bool operator==(const Layer& a, const Layer& b) {
+    return a.DomainSize == b.DomainSize && a.TextureSize == b.TextureSize && a.spec1 == b.spec1 && a.spec2 == b.spec2;
+}
+inline bool operator!=(const Layer& a, const Layer& b) {
+    return !(a == b);
+}
+// Storage precision of each pipeline stage, true = FP32, false = FP16
+struct OceanPrecision {
+    bool initialSpectrum = false;
+    bool evolvedSpectrum = false;
+    bool fftScratch = false;     // ping-pong array of the fallback FFT
+    bool outputs = false;        // displacement/foam and slope arrays
+};
+inline bool operator==(const OceanPrecision& a, const OceanPrecision& b) {
+    return a.initialSpectrum == b.initialSpectrum && a.evolvedSpectrum == b.evolvedSpectrum
+        && a.fftScratch == b.fftScratch && a.outputs == b.outputs;
+}
+inline bool operator!=(const OceanPrecision& a, const OceanPrecision& b) {
+    return !(a == b);
+}
+struct perChangeParameters {
+    int TextureSize;
+    int TextureCount;
+    int seed;
+    float lowCutOff;
+    float highCutOff;
+    float Gravity;
+    float Depth;
+    std::vector<Layer> layers;
+    OceanPrecision precision;
+};
+inline int LayerTextureSize(const perChangeParameters& parameters, int layer) {
+    int size = parameters.layers[layer].TextureSize;
+    return size > 0 ? size : parameters.TextureSize;
+}
+// Uniforms of time_evolution.cps / fftNormalize.cps, OceanFFTGenerator pushes them on every dispatch
+struct perFrameParameters {
+    int speed = 1;
+    float repeatTime = 200.0f;
+    glm::vec2 lambda = glm::vec2(1.0f, 1.0f);
+    float foamDecayRate = 0.0175f;
+    float foamBias = 0.85f;
+    float foamThreshold = 0.0f;
+    float foamAdd = 0.01f;
+    // cascade i updates every updateInterval[i] frames, see OceanFFTGenerator::Update
+    int updateInterval[MAX_CASCADES] = { 1, 1, 1, 1 };
+};
+
+// Layout matches SpectrumParameters in Spectrum_INIT.cps (std430)
+struct SpectrumSettings {
+    float scale;
+    float angle;
+    float spreadBlend;
+    float swell;
+    float alpha;
+    float peakOmega;
+    float gamma;
+    float shortWavesFade;
+};
+
+inline float JonswapAlpha(float fetch, float windSpeed, float gravity) {
+    return 0.076f * glm::pow(gravity * fetch / windSpeed / windSpeed, -0.22f);
+}
+
+inline float JonswapPeakFrequency(float fetch, float windSpeed, float gravity) {
+    return 22 * glm::pow(windSpeed * fetch / gravity / gravity, -0.33f);
+}
+
+inline void FillSpectrumStruct(const DisplaySpectrumSettings& displaySettings, SpectrumSettings& computeSettings, float gravity) {
+    computeSettings.scale = displaySettings.scale;
+    computeSettings.angle = displaySettings.windDirection / 180 * glm::pi<float>();
+    computeSettings.spreadBlend = displaySettings.spreadBlend;
+    computeSettings.swell = glm::clamp<float>(displaySettings.swell, 0.01f, 1);
+    computeSettings.alpha = JonswapAlpha(displaySettings.fetch, displaySettings.windSpeed, gravity);
+    computeSettings.peakOmega = JonswapPeakFrequency(displaySettings.fetch, displaySettings.windSpeed, gravity);
+    computeSettings.gamma = displaySettings.peakEnhancement;
+    computeSettings.shortWavesFade = displaySettings.shortWavesFade;
+}
+
+// The four cascades the app starts with
+inline void DefaultLayers(std::vector<Layer>& layers) {
+    DisplaySpectrumSettings settings[8];
+
+    // Spectrum 1
+    settings[0].scale = 0.1f;
+    settings[0].windSpeed = 2.0f;
+    settings[0].windDirection = 22.0f; // Assuming default value since it's not provided
+    settings[0].fetch = 100000.0f;
+    settings[0].spreadBlend = 0.642f; // Assuming default value since it's not provided
+    settings[0].swell = 1.0f;
+    settings[0].peakEnhancement = 1.0f;
+    settings[0].shortWavesFade = 0.025f;
+
+    // Spectrum 2
+    // Assuming default values for missing fields
+    settings[1].scale = 0.07f; // Not provided
+    settings[1].windSpeed = 2.0f;
+    settings[1].windDirection = 59.0f; // Not provided
+    settings[1].fetch = 1000; // Not provided
+    settings[1].spreadBlend = 0.0f; // Not provided
+    settings[1].swell = 1.0f; // Not provided
+    settings[1].peakEnhancement = 1.0f; // Not provided
+    settings[1].shortWavesFade = 0.01f; // Not provided
+
+    // Spectrum 3
+    settings[2].scale = 0.25f;
+    settings[2].windSpeed = 20.0f;
+    settings[2].windDirection = 97.0f; // Assuming default value since it's not provided
+    settings[2].fetch = 1e+08f;
+    settings[2].spreadBlend = 0.14f;
+    settings[2].swell = 1;
+    settings[2].peakEnhancement = 1.0f;
+    settings[2].shortWavesFade = 0.5f;
+
+    // Spectrum 4
+    settings[3].scale = 0.25f;
+    settings[3].windSpeed = 20.0f;
+    settings[3].windDirection = 67.0f; // Assuming default value since it's not provided
+    settings[3].fetch = 1000000.0f;
+    settings[3].spreadBlend = 0.47f;
+    settings[3].swell = 1.0f;
+    settings[3].peakEnhancement = 1.0f;
+    settings[3].shortWavesFade = 0.5f;
+
+    // Spectrum 5
+    settings[4].scale = 0.15f;
+    settings[4].windSpeed = 5.0f;
+    settings[4].windDirection = 105.0f; // Assuming default value since it's not provided
+    settings[4].fetch = 1000000.0f;
+    settings[4].spreadBlend = 0.2f; // Assuming default value since it's not provided
+    settings[4].swell = 1.0f;
+    settings[4].peakEnhancement = 1.0f;
+    settings[4].shortWavesFade = 0.5f;
+
+    // Spectrum 6
+    settings[5].scale = 0.1f;
+    settings[5].windSpeed = 1.0f; // Not provided
+    settings[5].windDirection = 19.0f; // Not provided
+    settings[5].fetch = 10000.0f;
+    settings[5].spreadBlend = 0.298f; // Not provided
+    settings[5].swell = 0.695f;
+    settings[5].peakEnhancement = 1.0f;
+    settings[5].shortWavesFade = 0.5f;
+
+    // Spectrum 7
+    settings[6].scale = 1.00f;
+    settings[6].windSpeed = 1.0f; // Not provided
+    settings[6].windDirection = 209.0f; // Not provided
+    settings[6].fetch = 200000.0f;
+    settings[6].spreadBlend = 0.56f; // Not provided
+    settings[6].swell = 1.0f;
+    settings[6].peakEnhancement = 1.0f;
+    settings[6].shortWavesFade = 0.0001f;
+
+    // Spectrum 8
+    settings[7].scale = 0.23f;
+    settings[7].windSpeed = 1.0f; // Not provided
+    settings[7].windDirection = 0.0f; // Not provided
+    settings[7].fetch = 1000.0f;
+    settings[7].spreadBlend = 0.0f; // Not provided
+    settings[7].swell = 0.0f;
+    settings[7].peakEnhancement = 1.0f;
+    settings[7].shortWavesFade = 0.0001f;
+
+    const int domainSizes[4] = { 94,128,64,32 };
+    layers.resize(4);
+    for (int index = 0; index < 4; ++index) {
+        layers[index].DomainSize = domainSizes[index];
+        layers[index].spec1 = settings[index * 2];
+        layers[index].spec2 = settings[index * 2 + 1];
+    }
+}
+
+// What the app bakes on startup: 512x512, the default layers and the default uniforms
+inline perChangeParameters DefaultParameters() {
+    perChangeParameters parameters;
+    parameters.TextureSize = 512;
+    parameters.TextureCount = 4;
+    parameters.seed = 1;
+    parameters.lowCutOff = 0.001f;
+    parameters.highCutOff = 9000;
+    parameters.Gravity = 9.81f;
+    parameters.Depth = 20;
+    DefaultLayers(parameters.layers);
+    return parameters;
+}
@@ -0,0 +1,289 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <oceanParameters.h>
+
+// FP64 reference of the OceanFFTGenerator stages for one cascade, what MeasureAccuracy holds the
+// GPU outputs against:
+//   InitialSpectrum -> Spectrum_INIT.cps + SpectrumConjugate.cps
+//   EvolveSpectrum  -> time_evolution.cps (two layers, same Hermitian pair packing)
+//   IFFT            -> horizontalFFT.cps + verticalFFT.cps, or stockhamFFT.cps
+//   Assemble        -> fftNormalize.cps
+// Values are carried in double throughout. The few discrete choices the shaders make (the random
+// draws, the cutoff test and the dispersion quantization) are taken in float the way the GPU takes
+// them, so a texel never lands on the other side of a branch and the errors stay about rounding.
+// Nothing in here touches OpenGL.
+namespace oceanReference {
+
+    const double PI = 3.14159265358979323846;
+
+    // max and RMS of value - reference over every component added, and the RMS of the reference
+    // itself to read the error against
+    struct StageError {
+        double maxError = 0;
+        double rmsError = 0;
+        double referenceRMS = 0;
+    };
+    class ErrorAccumulator {
+    public:
+        void Add(double value, double reference) {
+            double error = value - reference;
+            maxError = std::max(maxError, std::abs(error));
+            errorSum += error * error;
+            referenceSum += reference * reference;
+            ++count;
+        }
+        StageError Result() const {
+            StageError result;
+            if (count == 0)
+                return result;
+            result.maxError = maxError;
+            result.rmsError = std::sqrt(errorSum / count);
+            result.referenceRMS = std::sqrt(referenceSum / count);
+            return result;
+        }
+    private:
+        double maxError = 0, errorSum = 0, referenceSum = 0;
+        size_t count = 0;
+    };
+
+    // Spectrum_INIT.cps hash, float result like the shader's
+    inline float hash(uint32_t n) {
+        n = (n << 13U) ^ n;
+        n = n * (n * n * 15731U + 0x789221U);
+        n = n + 0x312589U;
+        n = n + (0x1376U << 24U);
+        return float(n & 0x7FFFFFFFU) / float(0x7FFFFFFF);
+    }
+
+    inline double Dispersion(double kMag, double gravity, double depth) {
+        return std::sqrt(gravity * kMag * std::tanh(std::min(kMag * depth, 20.0)));
+    }
+    inline double DispersionDerivative(double kMag, double gravity, double depth) {
+        double th = std::tanh(std::min(kMag * depth, 20.0));
+        double ch = std::cosh(kMag * depth);
+        return gravity * (depth * kMag / ch / ch + th) / Dispersion(kMag, gravity, depth) / 2.0;
+    }
+    inline double TMACorrection(double omega, double gravity, double depth) {
+        double omegaH = omega * std::sqrt(depth / gravity);
+        if (omegaH <= 1.0)
+            return 0.5 * omegaH * omegaH;
+        if (omegaH < 2.0)
+            return 1.0 - 0.5 * (2.0 - omegaH) * (2.0 - omegaH);
+        return 1.0;
+    }
+    inline double SpreadPower(double omega, double peakOmega) {
+        if (omega > peakOmega)
+            return 9.77 * std::pow(std::abs(omega / peakOmega), -2.5);
+        else
+            return 6.97 * std::pow(std::abs(omega / peakOmega), 5.0);
+    }
+    inline glm::dvec2 UniformToGaussian(double u1, double u2) {
+        double R = std::sqrt(-2.0 * std::log(u1));
+        double theta = 2.0 * PI * u2;
+        return glm::dvec2(R * std::cos(theta), R * std::sin(theta));
+    }
+    inline double JONSWAP(double omega, const SpectrumSettings& spectrum, double gravity, double depth) {
+        double peakOmega = spectrum.peakOmega;
+        double sigma = (omega <= peakOmega) ? 0.07 : 0.09;
+        double r = std::exp(-(omega - peakOmega) * (omega - peakOmega) / 2.0 / sigma / sigma / peakOmega / peakOmega);
+        double peakOmegaOverOmega = peakOmega / omega;
+        return spectrum.scale * TMACorrection(omega, gravity, depth) * spectrum.alpha * gravity * gravity
+            * std::pow(omega, -5.0) * std::exp(-1.25 * std::pow(peakOmegaOverOmega, 4.0))
+            * std::pow(std::abs((double)spectrum.gamma), r);
+    }
+    inline double NormalizationFactor(double s) {
+        double s2 = s * s;
+        double s3 = s2 * s;
+        double s4 = s3 * s;
+        if (s < 5) return -0.000564 * s4 + 0.00776 * s3 - 0.044 * s2 + 0.192 * s + 0.163;
+        else return -4.80e-08 * s4 + 1.07e-05 * s3 - 9.53e-04 * s2 + 5.90e-02 * s + 3.93e-01;
+    }
+    inline double DirectionSpectrum(double theta, double omega, const SpectrumSettings& spectrum) {
+        double s = SpreadPower(omega, spectrum.peakOmega) + 16 * std::tanh(std::min(omega / spectrum.peakOmega, 20.0)) * spectrum.swell * spectrum.swell;
+        double cosine2s = NormalizationFactor(s) * std::pow(std::abs(std::cos(0.5 * (theta - spectrum.angle))), 2.0 * s);
+        // the shader's 2 / 3.1415 is kept, it is part of the model rather than rounding
+        return glm::mix(2.0 / 3.1415 * std::cos(theta) * std::cos(theta), cosine2s, (double)spectrum.spreadBlend);
+    }
+    inline double ShortWavesFade(double kLength, const SpectrumSettings& spectrum) {
+        return std::exp(-(double)spectrum.shortWavesFade * spectrum.shortWavesFade * kLength * kLength);
+    }
+    inline glm::dvec2 ComplexMult(glm::dvec2 a, glm::dvec2 b) {
+        return glm::dvec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+    }
+
+    struct BakeSettings {
+        int size;            // texels per side
+        int cascade;         // index the shader mixes into the seed
+        double domainSize;
+        double gravity;
+        double depth;
+        float lowCutOff;
+        float highCutOff;
+        int seed;
+        const SpectrumSettings* spectrum1;
+        const SpectrumSettings* spectrum2;
+    };
+
+    // size*size texels: h0(k).xy, conj(h0(-k)).zw
+    inline void InitialSpectrum(const BakeSettings& bake, std::vector<glm::dvec4>& out) {
+        int N = bake.size;
+        out.assign((size_t)N * N, glm::dvec4(0.0));
+        uint32_t _N = (uint32_t)N;
+        double deltaK = 2.0 * PI / bake.domainSize;
+        float deltaKf = 2.0f * 3.14159265359f / (float)bake.domainSize;
+        for (int y = 0; y < N; ++y) {
+            for (int x = 0; x < N; ++x) {
+                uint32_t seed = (uint32_t)x + _N * (uint32_t)y + _N;
+                seed += (uint32_t)bake.seed;
+                seed += (uint32_t)(int)((float)bake.cascade + hash(seed) * 10);
+                glm::dvec2 gauss1 = UniformToGaussian(hash(seed), hash(seed * 2));
+                glm::dvec2 gauss2 = UniformToGaussian(hash(seed * 3), hash(seed * 4));
+
+                float kLengthf = glm::length((glm::vec2((float)x, (float)y) - N / 2.0f) * deltaKf);
+                if (!(bake.lowCutOff <= kLengthf && kLengthf <= bake.highCutOff))
+                    continue;
+                glm::dvec2 K = (glm::dvec2(x, y) - N / 2.0) * deltaK;
+                double kLength = glm::length(K);
+                double kAngle = std::atan2(K.y, K.x);
+                double omega = Dispersion(kLength, bake.gravity, bake.depth);
+                double dOmegadk = DispersionDerivative(kLength, bake.gravity, bake.depth);
+                double spectrum = JONSWAP(omega, *bake.spectrum1, bake.gravity, bake.depth)
+                    * DirectionSpectrum(kAngle, omega, *bake.spectrum1) * ShortWavesFade(kLength, *bake.spectrum1);
+                if (bake.spectrum2->scale > 0)
+                    spectrum += JONSWAP(omega, *bake.spectrum2, bake.gravity, bake.depth)
+                        * DirectionSpectrum(kAngle, omega, *bake.spectrum2) * ShortWavesFade(kLength, *bake.spectrum2);
+                glm::dvec2 h0 = glm::dvec2(gauss2.x, gauss1.y) * std::sqrt(2 * spectrum * std::abs(dOmegadk) / kLength * deltaK * deltaK);
+                out[(size_t)y * N + x] = glm::dvec4(h0, 0.0, 0.0);
+            }
+        }
+        // SpectrumConjugate.cps
+        for (int y = 0; y < N; ++y)
+            for (int x = 0; x < N; ++x) {
+                glm::dvec4& h0 = out[(size_t)y * N + x];
+                const glm::dvec4& conj = out[(size_t)((N - y) % N) * N + (N - x) % N];
+                h0.z = conj.x;
+                h0.w = -conj.y;
+            }
+    }
+
+    // initial (size*size) -> evolved (2 * size*size, layer 0 then layer 1)
+    inline void EvolveSpectrum(int N, double domainSize, double gravity, double repeatTime, double time,
+        const std::vector<glm::dvec4>& initial, std::vector<glm::dvec4>& out) {
+        out.assign((size_t)2 * N * N, glm::dvec4(0.0));
+        double w_0 = 2.0 * PI / repeatTime;
+        float w_0f = 2.0f * 3.14159265359f / (float)repeatTime;
+        float domainf = (float)domainSize;
+        for (int y = 0; y < N; ++y) {
+            for (int x = 0; x < N; ++x) {
+                size_t index = (size_t)y * N + x;
+                glm::dvec2 h0(initial[index].x, initial[index].y);
+                glm::dvec2 h0_conj(initial[index].z, initial[index].w);
+                glm::dvec2 K = (glm::dvec2(x, y) - N / 2.0) * 2.0 * PI / domainSize;
+                double kMag = glm::length(K);
+                double kMagRcp = kMag < 0.0001 ? 1.0 : 1.0 / kMag;
+
+                // frequency bin as the shader picks it, phase in double
+                float kMagf = glm::length((glm::vec2((float)x, (float)y) - N / 2.0f) * 2.0f * 3.14159265359f / domainf);
+                double bin = std::floor(std::sqrt((float)gravity * kMagf) / w_0f);
+                double dispersion = bin * w_0 * time;
+                glm::dvec2 exponent(std::cos(dispersion), std::sin(dispersion));
+                glm::dvec2 htilde = ComplexMult(h0, exponent) + ComplexMult(h0_conj, glm::dvec2(exponent.x, -exponent.y));
+                glm::dvec2 ih(-htilde.y, htilde.x);
+
+                glm::dvec2 displacementX = ih * K.x * kMagRcp;
+                glm::dvec2 displacementY = htilde;
+                glm::dvec2 displacementZ = ih * K.y * kMagRcp;
+                glm::dvec2 displacementX_dx = -htilde * K.x * K.x * kMagRcp;
+                glm::dvec2 displacementY_dx = ih * K.x;
+                glm::dvec2 displacementZ_dx = -htilde * K.x * K.y * kMagRcp;
+                glm::dvec2 displacementY_dz = ih * K.y;
+                glm::dvec2 displacementZ_dz = -htilde * K.y * K.y * kMagRcp;
+
+                out[index] = glm::dvec4(displacementX.x - displacementZ.y, displacementX.y + displacementZ.x,
+                    displacementY.x - displacementZ_dx.y, displacementY.y + displacementZ_dx.x);
+                out[(size_t)N * N + index] = glm::dvec4(displacementY_dx.x - displacementY_dz.y, displacementY_dx.y + displacementY_dz.x,
+                    displacementX_dx.x - displacementZ_dz.y, displacementX_dx.y + displacementZ_dz.x);
+            }
+        }
+    }
+
+    // in-place unnormalized inverse DFT (exp(+2 pi i kn / N)) of N values stride apart
+    inline void InverseFFT(glm::dvec2* data, int N, size_t stride) {
+        for (int i = 1, j = 0; i < N; ++i) {
+            int bit = N >> 1;
+            for (; j & bit; bit >>= 1)
+                j ^= bit;
+            j ^= bit;
+            if (i < j)
+                std::swap(data[i * stride], data[j * stride]);
+        }
+        for (int length = 2; length <= N; length <<= 1) {
+            for (int k = 0; k < length / 2; ++k) {
+                double angle = 2.0 * PI * k / length;
+                glm::dvec2 w(std::cos(angle), std::sin(angle));
+                for (int start = 0; start < N; start += length) {
+                    glm::dvec2& a = data[(start + k) * stride];
+                    glm::dvec2& b = data[(start + k + length / 2) * stride];
+                    glm::dvec2 t = ComplexMult(w, b);
+                    b = a - t;
+                    a = a + t;
+                }
+            }
+        }
+    }
+
+    // rows then columns of both complex signals of every layer in evolved (2 * size*size), in place
+    inline void IFFT(int N, std::vector<glm::dvec4>& evolved) {
+        std::vector<glm::dvec2> plane((size_t)N * N);
+        for (size_t layer = 0; layer < 2; ++layer) {
+            for (int half = 0; half < 2; ++half) {
+                glm::dvec4* texels = evolved.data() + layer * N * N;
+                for (size_t t = 0; t < (size_t)N * N; ++t)
+                    plane[t] = half == 0 ? glm::dvec2(texels[t].x, texels[t].y) : glm::dvec2(texels[t].z, texels[t].w);
+                for (int y = 0; y < N; ++y)
+                    InverseFFT(plane.data() + (size_t)y * N, N, 1);
+                for (int x = 0; x < N; ++x)
+                    InverseFFT(plane.data() + x, N, N);
+                for (size_t t = 0; t < (size_t)N * N; ++t) {
+                    if (half == 0) { texels[t].x = plane[t].x; texels[t].y = plane[t].y; }
+                    else { texels[t].z = plane[t].x; texels[t].w = plane[t].y; }
+                }
+            }
+        }
+    }
+
+    // transformed (2 * size*size) -> displacement/foam and slope, previousFoam is the .w the
+    // shader's FoamSource held (size*size)
+    inline void Assemble(int N, const std::vector<glm::dvec4>& transformed, const perFrameParameters& frame,
+        const std::vector<double>& previousFoam, std::vector<glm::dvec4>& displacement, std::vector<glm::dvec2>& slope) {
+        displacement.resize((size_t)N * N);
+        slope.resize((size_t)N * N);
+        glm::dvec2 lambda = frame.lambda;
+        for (int y = 0; y < N; ++y) {
+            for (int x = 0; x < N; ++x) {
+                size_t index = (size_t)y * N + x;
+                // Permute: k runs from -N/2, which the transform leaves as (-1)^(x+y)
+                double sign = ((x + y) % 2) ? -1.0 : 1.0;
+                glm::dvec4 htildeDisplacement = transformed[index] * sign;
+                glm::dvec4 htildeSlope = transformed[(size_t)N * N + index] * sign;
+                glm::dvec2 dxdz(htildeDisplacement.x, htildeDisplacement.y);
+                glm::dvec2 dydxz(htildeDisplacement.z, htildeDisplacement.w);
+                glm::dvec2 dyxdyz(htildeSlope.x, htildeSlope.y);
+                glm::dvec2 dxxdzz(htildeSlope.z, htildeSlope.w);
+
+                double jacobian = (1.0 + lambda.x * dxxdzz.x) * (1.0 + lambda.y * dxxdzz.y) - lambda.x * lambda.y * dydxz.y * dydxz.y;
+                double foam = glm::clamp(previousFoam[index] * std::exp(-(double)frame.foamDecayRate), 0.0, 1.0);
+                double biasedJacobian = std::max(0.0, -(jacobian - frame.foamBias));
+                if (biasedJacobian > frame.foamThreshold)
+                    foam += frame.foamAdd * biasedJacobian;
+
+                displacement[index] = glm::dvec4(lambda.x * dxdz.x, dydxz.x, lambda.y * dxdz.y, foam);
+                slope[index] = dyxdyz / (1.0 + glm::abs(dxxdzz * lambda));
+            }
+        }
+    }
+}
@@ -0,0 +1,207 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <oceanParameters.h>
+
+// Baked playback file: one RepeatTime period of every cascade's displacement/foam (RGBA) and
+// slope (RG) as FP16, sampled at a fixed frame rate. time_evolution.cps rounds every frequency
+// to a multiple of 2pi/RepeatTime, so the last frame wraps seamlessly into the first.
+//
+// Layout: Header, frameCount + 1 offsets, then the frames. A frame holds one block per cascade,
+// each the half words XORed with the previous frame (except key frames), split into low and high
+// byte planes and PackBits run length coded. Neighbouring frames share sign/exponent bits, so the
+// high plane is mostly zero runs.
+// Nothing in here touches OpenGL, OceanFFTGenerator bakes and plays the file.
+
+class OceanSequence
+{
+public:
+    static const uint32_t MAGIC = 0x5145534f;   // "OSEQ"
+    static const uint32_t VERSION = 1;
+    static const int KEY_INTERVAL = 32;          // frames between key frames, bounds the cost of a seek
+
+    struct Header {
+        uint32_t magic = MAGIC;
+        uint32_t version = VERSION;
+        int32_t cascadeCount = 0;
+        int32_t sizes[MAX_CASCADES] = { 0, 0, 0, 0 };
+        int32_t frameCount = 0;
+        int32_t keyInterval = KEY_INTERVAL;
+        float frameRate = 0;
+        float repeatTime = 0;
+    };
+
+    // half words of one cascade: size*size RGBA displacement followed by size*size RG slope
+    static size_t CascadeWords(int size) {
+        return (size_t)size * size * 6;
+    }
+
+    // frames have to be appended in order, Finish writes the offset table
+    class Writer {
+    public:
+        bool Open(const std::string& path, const Header& header) {
+            this->header = header;
+            file.open(path, std::ios::binary | std::ios::trunc);
+            if (!file)
+                return false;
+            offsets.assign(1, sizeof(Header) + (header.frameCount + 1) * sizeof(uint64_t));
+            previous.assign(header.cascadeCount, {});
+            file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+            std::vector<uint64_t> placeholder(header.frameCount + 1, 0);
+            file.write(reinterpret_cast<const char*>(placeholder.data()), placeholder.size() * sizeof(uint64_t));
+            return (bool)file;
+        }
+        // cascades[c] holds CascadeWords(sizes[c]) words
+        void Append(const std::vector<std::vector<uint16_t>>& cascades) {
+            bool key = (offsets.size() - 1) % header.keyInterval == 0;
+            std::vector<uint8_t> block;
+            for (int c = 0; c < header.cascadeCount; ++c) {
+                Encode(cascades[c], key ? nullptr : &previous[c], block);
+                uint32_t bytes = (uint32_t)block.size();
+                file.write(reinterpret_cast<const char*>(&bytes), sizeof(bytes));
+                file.write(reinterpret_cast<const char*>(block.data()), block.size());
+                previous[c] = cascades[c];
+            }
+            offsets.push_back((uint64_t)file.tellp());
+        }
+        // bytes written, 0 when the file is incomplete or a write failed
+        uint64_t Finish() {
+            if ((int)offsets.size() != header.frameCount + 1 || !file)
+                return 0;
+            file.seekp(sizeof(Header));
+            file.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+            file.close();
+            return offsets.back();
+        }
+    private:
+        Header header;
+        std::ofstream file;
+        std::vector<uint64_t> offsets;
+        std::vector<std::vector<uint16_t>> previous;
+    };
+
+    // decodes frames on request, cheapest when they are asked for in order
+    class Reader {
+    public:
+        bool Open(const std::string& path) {
+            file.open(path, std::ios::binary);
+            if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(Header)))
+                return false;
+            if (header.magic != MAGIC || header.version != VERSION || header.frameCount <= 0
+                || header.cascadeCount <= 0 || header.cascadeCount > MAX_CASCADES || header.keyInterval <= 0)
+                return false;
+            offsets.resize(header.frameCount + 1);
+            if (!file.read(reinterpret_cast<char*>(offsets.data()), offsets.size() * sizeof(uint64_t)))
+                return false;
+            current.assign(header.cascadeCount, {});
+            for (int c = 0; c < header.cascadeCount; ++c)
+                current[c].assign(CascadeWords(header.sizes[c]), 0);
+            decoded = -1;
+            return true;
+        }
+        const Header& Info() const {
+            return header;
+        }
+        // the words of frame, valid until the next call
+        const std::vector<std::vector<uint16_t>>* Frame(int frame) {
+            if (frame < 0 || frame >= header.frameCount)
+                return nullptr;
+            if (frame != decoded) {
+                // deltas chain from the last key frame, continue from the decoded frame when possible
+                int start = frame - frame % header.keyInterval;
+                if (decoded >= start && decoded < frame)
+                    start = decoded + 1;
+                for (int f = start; f <= frame; ++f)
+                    if (!DecodeFrame(f))
+                        return nullptr;
+            }
+            return &current;
+        }
+    private:
+        bool DecodeFrame(int frame) {
+            decoded = -1;
+            file.clear();
+            file.seekg(offsets[frame]);
+            bool key = frame % header.keyInterval == 0;
+            std::vector<uint8_t> block;
+            for (int c = 0; c < header.cascadeCount; ++c) {
+                uint32_t bytes = 0;
+                if (!file.read(reinterpret_cast<char*>(&bytes), sizeof(bytes)))
+                    return false;
+                block.resize(bytes);
+                if (!file.read(reinterpret_cast<char*>(block.data()), bytes) || !Decode(block, key, current[c]))
+                    return false;
+            }
+            decoded = frame;
+            return true;
+        }
+        Header header;
+        std::ifstream file;
+        std::vector<uint64_t> offsets;
+        std::vector<std::vector<uint16_t>> current;
+        int decoded = -1;
+    };
+
+private:
+    static void Encode(const std::vector<uint16_t>& words, const std::vector<uint16_t>* previous, std::vector<uint8_t>& out) {
+        size_t count = words.size();
+        std::vector<uint8_t> planes(count * 2);
+        for (size_t i = 0; i < count; ++i) {
+            uint16_t w = previous ? uint16_t(words[i] ^ (*previous)[i]) : words[i];
+            planes[i] = uint8_t(w);
+            planes[count + i] = uint8_t(w >> 8);
+        }
+        out.clear();
+        // PackBits: n < 128 is n + 1 literal bytes, n >= 128 repeats the next byte n - 126 times
+        size_t i = 0;
+        while (i < planes.size()) {
+            size_t run = 1;
+            while (i + run < planes.size() && run < 129 && planes[i + run] == planes[i])
+                ++run;
+            if (run >= 2) {
+                out.push_back(uint8_t(run + 126));
+                out.push_back(planes[i]);
+                i += run;
+                continue;
+            }
+            size_t literal = 1;
+            while (i + literal < planes.size() && literal < 128
+                && !(i + literal + 1 < planes.size() && planes[i + literal] == planes[i + literal + 1]))
+                ++literal;
+            out.push_back(uint8_t(literal - 1));
+            out.insert(out.end(), planes.begin() + i, planes.begin() + i + literal);
+            i += literal;
+        }
+    }
+    // words holds the previous frame on entry unless key
+    static bool Decode(const std::vector<uint8_t>& in, bool key, std::vector<uint16_t>& words) {
+        size_t count = words.size();
+        std::vector<uint8_t> planes;
+        planes.reserve(count * 2);
+        size_t i = 0;
+        while (i < in.size()) {
+            uint8_t control = in[i++];
+            if (control < 128) {
+                size_t literal = control + 1;
+                if (i + literal > in.size())
+                    return false;
+                planes.insert(planes.end(), in.begin() + i, in.begin() + i + literal);
+                i += literal;
+            }
+            else {
+                if (i >= in.size())
+                    return false;
+                planes.insert(planes.end(), size_t(control) - 126, in[i++]);
+            }
+        }
+        if (planes.size() != count * 2)
+            return false;
+        for (size_t w = 0; w < count; ++w) {
+            uint16_t value = uint16_t(planes[w] | (planes[count + w] << 8));
+            words[w] = key ? value : uint16_t(words[w] ^ value);
+        }
+        return true;
+    }
+};
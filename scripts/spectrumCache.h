@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <fileFinder.h>
+#include <oceanParameters.h>
+
+// On-disk cache of baked initial spectra (Spectrum_INIT.cps + SpectrumConjugate.cps output).
+// One file per cascade under cache/, named after a hash of everything the bake reads,
+// holding the raw texels of initialSpectrum as glGetTextureImage returns them.
+// Nothing in here touches OpenGL, OceanFFTGenerator does the download/upload.
+
+// bump when Spectrum_INIT.cps or SpectrumConjugate.cps change what they write
+const uint32_t SPECTRUM_CACHE_VERSION = 1;
+
+class SpectrumCache
+{
+public:
+    // FNV-1a over the inputs of one cascade's bake
+    static uint64_t Key(const perChangeParameters& parameters, int layer, int size, bool fp32) {
+        uint64_t hash = 14695981039346656037ull;
+        auto add = [&hash](const void* data, size_t bytes) {
+            const unsigned char* p = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < bytes; ++i) {
+                hash ^= p[i];
+                hash *= 1099511628211ull;
+            }
+        };
+        auto addSettings = [&add](const DisplaySpectrumSettings& s) {
+            const float fields[] = { s.scale, s.windSpeed, s.windDirection, s.fetch,
+                                     s.spreadBlend, s.swell, s.peakEnhancement, s.shortWavesFade };
+            add(fields, sizeof(fields));
+        };
+        const Layer& l = parameters.layers[layer];
+        const int ints[] = { (int)SPECTRUM_CACHE_VERSION, parameters.seed, layer, size, l.DomainSize, fp32 ? 1 : 0 };
+        const float floats[] = { parameters.lowCutOff, parameters.highCutOff, parameters.Gravity, parameters.Depth };
+        add(ints, sizeof(ints));
+        add(floats, sizeof(floats));
+        addSettings(l.spec1);
+        addSettings(l.spec2);
+        return hash;
+    }
+
+    // false on a miss or when the file doesn't hold exactly bytes of texels
+    static bool Load(uint64_t key, size_t bytes, std::vector<unsigned char>& texels) {
+        std::ifstream file(FilePath(key), std::ios::binary);
+        if (!file)
+            return false;
+        Header header;
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || !Matches(header, key, bytes))
+            return false;
+        texels.resize(bytes);
+        return (bool)file.read(reinterpret_cast<char*>(texels.data()), bytes);
+    }
+
+    static void Save(uint64_t key, const std::vector<unsigned char>& texels) {
+        std::error_code error;
+        std::filesystem::create_directories(Directory(), error);
+        // write under a temporary name so an interrupted save never looks like a hit
+        std::string path = FilePath(key);
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file)
+                return;
+            Header header = { MAGIC, SPECTRUM_CACHE_VERSION, key, (uint64_t)texels.size() };
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(texels.data()), texels.size());
+            if (!file)
+                return;
+        }
+        std::filesystem::rename(temporary, path, error);
+    }
+
+private:
+    static const uint32_t MAGIC = 0x30484353;   // "SCH0"
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint64_t bytes;
+    };
+    static bool Matches(const Header& header, uint64_t key, size_t bytes) {
+        return header.magic == MAGIC && header.version == SPECTRUM_CACHE_VERSION && header.key == key && header.bytes == bytes;
+    }
+    static std::string Directory() {
+        return fileFinder::getPath("cache");
+    }
+    static std::string FilePath(uint64_t key) {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.h0", (unsigned long long)key);
+        return (std::filesystem::path(Directory()) / name).string();
+    }
+};
@@ -0,0 +1,104 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads for the CPU-side ocean code.
+// parallelFor hands out indices [0, count) to the workers and the calling thread and
+// blocks until every index has run, so callers can treat it like a plain loop.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned threadCount = 0) {
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        // The calling thread works too, so spawn one less
+        for (unsigned i = 1; i < threadCount; ++i)
+            workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const {
+        return (unsigned)workers.size() + 1;
+    }
+
+    void parallelFor(int count, const std::function<void(int)>& function) {
+        if (count <= 0)
+            return;
+        if (workers.empty() || count == 1) {
+            for (int i = 0; i < count; ++i)
+                function(i);
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this] { return busy == 0; });
+            job = &function;
+            jobCount = count;
+            next = 0;
+            ++generation;
+        }
+        wake.notify_all();
+
+        runJob(function, count);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return busy == 0; });
+        job = nullptr;
+    }
+
+private:
+    void runJob(const std::function<void(int)>& function, int count) {
+        for (int i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+            function(i);
+    }
+    void workerLoop() {
+        unsigned seen = 0;
+        for (;;) {
+            const std::function<void(int)>* function;
+            int count;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+                function = job;
+                count = jobCount;
+                ++busy;
+            }
+            if (function)
+                runJob(*function, count);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                --busy;
+            }
+            done.notify_all();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int)>* job = nullptr;
+    int jobCount = 0;
+    std::atomic<int> next{ 0 };
+    unsigned generation = 0;
+    int busy = 0;
+    bool stopping = false;
+};
@@ -6,7 +6,7 @@ in vec2 TexCoords;
 uniform int _TextureZ=0;
 uniform sampler2D screenTexture;
 uniform sampler2D depthTexture;
-uniform sampler2DArray DisplacementTextures; 
+uniform sampler2DArray DisplacementTextures[4];   // one per cascade
 
 // Camera and fog parameters
 uniform float nearPlane = 0.1;
@@ -97,7 +97,7 @@ void main()
     // Sample the water displacement textures (assumed to store water-surface heights in red channel).
     float waterHeight = 0.0;
     for (int i = 0; i < _TextureZ ;++i) {
-        waterHeight += texture(DisplacementTextures, vec3(TexCoords, float(i))).r;
+        waterHeight += texture(DisplacementTextures[i], vec3(TexCoords, 0)).r;
     }
     waterHeight /= 4.0;  // Average the displacement heights
 
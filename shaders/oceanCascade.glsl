@@ -0,0 +1,16 @@
+// shared by oceanFFT.tes and oceanFFT.frag, pulled in by the #include the shader loader resolves
+
+// Mip level of cascade at a footprint (world units per pixel) and how much of it to keep. The lod
+// is the footprint against the cascade's shortest wavelength, two texels; the cascade fades out
+// once that ratio reaches its longest (tileSize), which is then under two pixels, whether or not
+// the mip chain goes that far. Past the last mip the lod stays on it.
+float CascadeWeight(sampler2DArray cascade, float tileSize, float footprint, out float lod) {
+    float size = float(textureSize(cascade, 0).x);
+    float shortestWave = 2.0 * tileSize / size;
+    float waveLod = max(log2(2.0 * footprint / shortestWave), 0.0);
+    lod = min(waveLod, float(textureQueryLevels(cascade) - 1));
+    float cutoff = log2(tileSize / shortestWave);
+    if (cutoff < 1.0)
+        return 1.0;
+    return 1.0 - smoothstep(cutoff - 1.0, cutoff, waveLod);
+}
@@ -29,8 +29,10 @@ uniform float _DisplacementDepthAttenuation = 1.0;
 uniform float _UnderwaterFadeStrength=2;
 uniform mat4 inverse_model;
 uniform samplerCube _EnvironmentMap;
-uniform sampler2DArray _DisplacementTextures;  
-uniform sampler2DArray _SlopeTextures;
+// one array per cascade (MAX_CASCADES), each cascade has its own resolution
+uniform sampler2DArray _DisplacementTextures[4];  
+uniform sampler2DArray _SlopeTextures[4];
+uniform float _TileSizes[4];       // world units per repeat of each cascade, its DomainSize
 uniform sampler2D _SceneColor;
 
 // Smith masking using the Beckmann distribution
@@ -47,20 +49,26 @@ float Beckmann(float ndoth, float roughness) {
     return exp(exp_arg) / (PI * roughness * roughness * ndoth * ndoth * ndoth * ndoth);
 }
 
+#include "oceanCascade.glsl"
+
 void main() {
     // Normalize light and view directions.
     vec3 lightDir = -normalize(_lightDir);
     vec3 viewDir = normalize(cameraPos - pos);
     vec3 halfwayDir = normalize(lightDir + viewDir);
 
-    vec4 displacementFoam;
-    for(int i=0;i<_TextureZ;++i){
-   displacementFoam += textureLod(_DisplacementTextures, vec3(uv, i), 0.0);
-    }
-    vec2 slopes ;
-     for(int i=0;i<_TextureZ;++i){
-    
- slopes += textureLod(_SlopeTextures, vec3(uv, 0), 0.0).rg;
+    // world units one pixel covers, uv is the undisplaced world position
+    float footprint = max(length(dFdx(uv)), length(dFdy(uv)));
+    vec4 displacementFoam = vec4(0.0);
+    vec2 slopes = vec2(0.0);
+    for (int i = 0; i < _TextureZ; ++i) {
+        float lod;
+        float weight = CascadeWeight(_DisplacementTextures[i], _TileSizes[i], footprint, lod);
+        if (weight <= 0.0)
+            continue;
+        vec3 cascadeUV = vec3(uv / _TileSizes[i], 0);
+        displacementFoam += weight * textureLod(_DisplacementTextures[i], cascadeUV, lod);
+        slopes += weight * textureLod(_SlopeTextures[i], cascadeUV, lod).rg;
     }
     slopes *= _NormalStrength;
 
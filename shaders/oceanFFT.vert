@@ -1,15 +1,18 @@
 #version 430
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 2) in vec2 inTexCoord;
 
-uniform sampler2DArray _DisplacementTextures; 
+uniform sampler2DArray _DisplacementTextures[4]; 
 uniform float _DisplacementDepthAttenuation=1;
+// one clipmap tile per instance, written by oceanPatchCull.cps: xz origin, patch width, level.
+// The tile is a grid of _TilePatches x _TilePatches patches, its vertices numbered row by row,
+// so gl_VertexID is all the position it needs.
+layout(location = 3) in vec4 inTile;
+uniform int _TilePatches = 4;
 
+out int patchLevel;
 
-
-void main() {          
-gl_Position= vec4(inPosition,1);     
-				
+void main() {
+    vec2 corner = vec2(gl_VertexID % (_TilePatches + 1), gl_VertexID / (_TilePatches + 1));
+    patchLevel = int(inTile.w);
+    gl_Position = vec4(inTile.x + corner.x * inTile.z, 0.0, inTile.y + corner.y * inTile.z, 1);
 }
-